@@ -15,6 +15,7 @@ start:
     mov es, ax
     mov ss, ax
     mov sp, 0x7000
+    mov [boot_drive], dl    ; BIOS boot drive (0x00 floppy, 0x80 disk)
     sti
 
     ; Write 'B' to VGA text buffer at 0xB8000
@@ -26,16 +27,16 @@ start:
     mov si, msg_loading
     call print_string
 
-    ; === Load loader from sector 2 using CHS ===
+    ; === Load loader (LOADER_SECTORS sectors) from sector 2 using CHS ===
     mov ax, 0x0100
     mov es, ax
     xor bx, bx
 
-    mov al, 1               ; read 1 sector
+    mov al, LOADER_SECTORS  ; read the whole loader
     mov ch, 0               ; cylinder 0
     mov cl, 2               ; sector 2 (1-indexed, loader is here)
     mov dh, 0               ; head 0
-    mov dl, 0x80            ; drive 0 (hard drive)
+    mov dl, [boot_drive]
     mov ah, 0x02            ; INT 13h AH=0x02: read sectors
     int 0x13
     jc .load_error
@@ -63,6 +64,9 @@ start:
     mov byte [es:0x04], 'J'
     mov byte [es:0x05], 0x0A
     
+    ; The loader reads the kernel from the same drive
+    mov dl, [boot_drive]
+
     ; Push return address and jump via retf
     ; Push segment first (LIFO), then offset
     push 0x0100     ; segment
@@ -92,6 +96,8 @@ print_string:
 .ps_done:
     ret
 
+boot_drive:         db 0x80
+
 msg_loading:        db "[BOOT] Loading kernel loader...", 0x0D, 0x0A, 0
 msg_jumping:        db "[BOOT] Jumping to loader", 0x0D, 0x0A, 0
 msg_before_jump:    db "[BOOT] Preparing to jump to loader...", 0x0D, 0x0A, 0
@@ -3,6 +3,55 @@
 
 %include "boot/kernel_sectors.inc"
 
+; ------------------------------------------
+; Optional VESA framebuffer (assemble with -DENABLE_VESA)
+; The handoff block layout is mirrored by VbeHandoff in src/fbconsole.h
+; ------------------------------------------
+%ifndef VBE_WIDTH
+%define VBE_WIDTH 1280
+%endif
+%ifndef VBE_HEIGHT
+%define VBE_HEIGHT 800
+%endif
+
+VBE_HANDOFF     equ 0x0600      ; handoff block read by the kernel
+VBE_MODE_INFO   equ 0x0700      ; 256-byte scratch for INT 10h AX=4F01
+VBE_CTRL_INFO   equ 0x0800      ; 512-byte scratch for INT 10h AX=4F00
+VBE_FONT        equ 0x5000      ; copy of the BIOS 8x16 font (4 KiB)
+VBE_MAGIC       equ 0x31454256  ; 'VBE1'
+
+; ------------------------------------------
+; Kernel loading
+; The kernel image on disk is its ELF file. Each PT_LOAD segment's file
+; bytes are read to p_paddr (above 1 MiB, out of reach of real-mode BIOS
+; calls: every read lands in a bounce buffer below 1 MiB and is copied up
+; in unreal mode, see copy_high) and the rest of p_memsz (.bss) is zeroed.
+; ------------------------------------------
+ELF_HEADER_SEG   equ 0x0300      ; first sector of the image: ELF + program headers
+ELF_HEADER       equ 0x3000
+ELF_MAGIC        equ 0x464C457F  ; 0x7F 'E' 'L' 'F'
+EM_386           equ 3
+PT_LOAD          equ 1
+KERNEL_STACK     equ 0x00088000  ; boot stack in conventional memory
+BOUNCE_SEG       equ 0x1000      ; 64 KiB-aligned, so no read crosses a DMA boundary
+BOUNCE_LINEAR    equ 0x10000
+EDD_MAX_SECTORS  equ 127         ; largest count every INT 13h AH=42h accepts
+READ_RETRIES     equ 3           ; floppies often need a reset and a retry
+
+; ------------------------------------------
+; Compressed image (KERNEL_COMPRESSED=1 in kernel_sectors.inc)
+; The disk holds kernel.img as one raw LZ4 block. It is read whole to
+; KERNEL_PACKED and unpacked to KERNEL_UNPACKED, and the ELF segments are
+; then copied out of memory instead of read from disk. Both buffers sit
+; above the highest address the kernel may occupy (checked per segment),
+; so the machine needs 32 MiB.
+; ------------------------------------------
+%ifndef KERNEL_COMPRESSED
+%assign KERNEL_COMPRESSED 0
+%endif
+KERNEL_PACKED    equ 0x01000000  ; 16 MiB: compressed image as read from disk
+KERNEL_UNPACKED  equ 0x01800000  ; 24 MiB: the ELF file, unpacked
+
 ; ------------------------------------------
 ; Serial output macro (for debugging)
 ; Usage: serial_write 'A'
@@ -34,6 +83,14 @@ loader_start:
     mov es, ax
     mov ss, ax
     mov sp, 0x1000      ; Stack at 0x01000:0x1000 = 0x2000 linear
+    mov [boot_drive], dl    ; BIOS boot drive, passed on by the bootloader
+
+    ; No framebuffer unless setup_vesa succeeds later
+    xor ax, ax
+    mov es, ax
+    mov dword [es:VBE_HANDOFF], 0
+    mov ax, 0x0100
+    mov es, ax
     
     ; Print startup message to verify loader is executing
     mov si, msg_loader_here
@@ -43,54 +100,41 @@ loader_start:
     mov si, msg_about_read
     call print_string
 
-    ; NOW: Load kernel from disk via INT 13 CHS read (REAL MODE, safe)
-    ; Kernel is KERNEL_SECTORS sectors, starting at sector 3 (1-based CHS)
-    ; (Sector 1 = bootloader, Sector 2 = loader, Sector 3+ = kernel)
-    ; Destination: 0x90000 (linear) = ES:0x0000 with ES=0x9000
-    
-    ; Set up segments for disk read
-    mov ax, 0x9000
-    mov es, ax              ; ES = destination segment
-    xor bx, bx              ; BX = offset within ES (0x0000)
-    
-    ; Prepare to read KERNEL_SECTORS sectors starting at sector 3 (1-based CHS)
-    ; Try reading with drive 0x80 (hard drive) since floppy (0x00) might not work
-    mov dl, 0x80            ; Drive 0 (as hard drive)
-    mov dh, 0x00            ; Head 0
-    mov ch, 0x00            ; Cylinder 0
-    mov cl, 0x03            ; Sector 3 (1-based)
-    
-    ; Read KERNEL_SECTORS sectors, but limit to 18 at a time for CHS safety
-    ; (CHS can wrap, but 18 sectors should fit in one track)
-    mov ah, 0x02            ; INT 13 AH=02: read sectors
-    mov al, 18              ; Read 18 sectors at a time (limits CHS wrapping issues)
-    cmp al, KERNEL_SECTORS
-    jle .read_kernel
-    mov al, KERNEL_SECTORS  ; If KERNEL_SECTORS < 18, read only what we need
-    
-.read_kernel:
-    int 0x13
-    
-    ; Restore segment registers for code execution
-    mov ax, 0x0100
-    mov ds, ax
-    mov es, ax
-    
-    ; Check carry flag for error
+    ; A20 first: the kernel segments live above 1 MiB
+    call enable_a20
+    jc .a20_error
+
+    ; The GDT is also what copy_high uses to reach unreal mode
+    lea bx, [gdt_ptr]
+    lgdt [bx]
+
+    call load_kernel
     jc .read_error
-    
+
     ; Success!
     mov si, msg_kernel_ok
     call print_string
     jmp .kernel_valid
-    
+
+.a20_error:
+    mov si, msg_a20_err
+    call print_string
+    jmp .halt_error
+
 .read_error:
     ; Error reading kernel
     mov si, msg_kernel_err
     call print_string
     jmp .halt_error
-    
+
 .kernel_valid:
+%ifdef ENABLE_VESA
+    ; Last BIOS video call: after the mode switch teletype output is gone
+    mov si, msg_vesa
+    call print_string
+    call setup_vesa
+%endif
+
     ; About to enter PM
     mov si, msg_pm_entry
     call print_string
@@ -103,13 +147,10 @@ loader_start:
     mov byte [es:0x02], 'M'
     mov byte [es:0x03], 0x0A
     
-    ; Prepare to enter protected mode and jump to kernel at 0x90000
-
-    ; Load GDT - load address directly 
+    ; Prepare to enter protected mode and jump to the kernel
+    ; (the GDT was loaded before the kernel was read)
     mov ax, 0x0100
     mov ds, ax
-    lea bx, [gdt_ptr]
-    lgdt [bx]
 
     ; Disable interrupts during mode switch
     cli
@@ -121,8 +162,8 @@ loader_start:
 
     ; CRITICAL: Far jump immediately after PE bit set
     ; This jumps to protected mode code and reloads CS
-    ; Use hardcoded address 0x1190 which is where pm_entry_32 actually is
-    jmp 0x08:0x1190
+    ; The loader is assembled at org 0 and runs at linear 0x1000
+    jmp 0x08:(pm_entry_32 + 0x1000)
 
 .halt:
     hlt
@@ -138,7 +179,39 @@ msg_loader_start:   db "[LOADER] Loader started", 0x0D, 0x0A, 0
 msg_about_read:     db "[LOADER] Reading kernel from disk...", 0x0D, 0x0A, 0
 msg_kernel_ok:      db "[LOADER] Kernel loaded successfully", 0x0D, 0x0A, 0
 msg_kernel_err:     db "[LOADER] Failed to read kernel from disk", 0x0D, 0x0A, 0
+msg_a20_err:        db "[LOADER] Could not enable the A20 line", 0x0D, 0x0A, 0
 msg_pm_entry:       db "[LOADER] Entering protected mode...", 0x0D, 0x0A, 0
+%ifdef ENABLE_VESA
+msg_vesa:           db "[LOADER] Switching to VESA framebuffer...", 0x0D, 0x0A, 0
+%endif
+
+; Kernel start sector (LBA); placeholder patched by scripts/patch_loader_dap.py
+kernel_lba:         dq 0x1122334455667788
+
+; Read state
+boot_drive:         db 0x80
+use_edd:            db 0
+sectors_per_track:  dw 0
+head_count:         dw 0
+next_lba:           dd 0
+next_dest:          dd 0
+range_offset:       dd 0        ; load_range: image offset still to read
+range_left:         dd 0        ; load_range: bytes still to read
+range_skip:         dw 0        ; load_range: bytes to skip in the first sector
+kernel_entry:       dd 0        ; e_entry, jumped to from pm_entry_32
+ph_offset:          dw 0        ; next program header in ELF_HEADER
+ph_left:            dw 0
+ph_size:            dw 0
+
+; INT 13h AH=42h disk address packet
+align 4
+dap:
+                    db 0x10     ; packet size
+                    db 0
+dap_count:          dw 0
+dap_offset:         dw 0
+dap_segment:        dw BOUNCE_SEG
+dap_lba:            dq 0
 
 ; ========== GDT (Global Descriptor Table) =========
 ; Print string using INT 10h (teletype mode) - same as bootloader
@@ -159,6 +232,545 @@ print_string:
     ret
 ; (all messages now inline VGA writes to avoid INT 10h overhead)
 
+; ------------------------------------------
+; enable_a20: fast A20 through System Control Port A (0x92), falling back
+; to the BIOS (INT 15h AX=2401). CF set if the line is still off.
+; ------------------------------------------
+enable_a20:
+    call a20_check
+    jnc .done
+    in al, 0x92
+    test al, 0x02
+    jnz .bios
+    or al, 0x02
+    and al, 0xFE            ; bit 0 is a fast CPU reset; never set it
+    out 0x92, al
+    call a20_check
+    jnc .done
+.bios:
+    mov ax, 0x2401
+    int 0x15
+    call a20_check
+.done:
+    ret
+
+; a20_check: CF set if 0xFFFF:0x0510 wraps around to 0x0000:0x0500
+a20_check:
+    push ds
+    push es
+    xor ax, ax
+    mov ds, ax
+    not ax
+    mov es, ax
+    mov bl, [0x0500]
+    mov bh, [es:0x0510]
+    mov byte [0x0500], 0x00
+    mov byte [es:0x0510], 0xFF
+    mov al, [0x0500]        ; 0xFF only if the second write wrapped
+    mov [es:0x0510], bh
+    mov [0x0500], bl
+    pop es
+    pop ds
+    cmp al, 0xFF
+    je .off
+    clc
+    ret
+.off:
+    stc
+    ret
+
+; ------------------------------------------
+; load_kernel: load the ELF image at [kernel_lba]: every PT_LOAD segment's
+; file bytes go to p_paddr and the remaining p_memsz - p_filesz bytes are
+; zeroed. The entry point is left in [kernel_entry]. CF set on a read
+; error, a corrupt compressed image or if the image is not an i386 ELF file.
+; ------------------------------------------
+load_kernel:
+    call detect_drive
+    jc .fail
+
+%if KERNEL_COMPRESSED
+    ; One pass over the disk for the whole image, then work from memory
+    xor eax, eax
+    mov edi, KERNEL_PACKED
+    mov ecx, KERNEL_SIZE_BYTES
+    call read_range
+    jc .fail
+    call unpack_kernel
+    jc .fail
+%endif
+
+    ; ELF header and program headers (ld puts them in the first sector)
+    xor eax, eax
+    mov edi, ELF_HEADER
+    mov ecx, 512
+    call load_range
+    jc .fail
+
+    mov ax, ELF_HEADER_SEG
+    mov fs, ax
+    cmp dword [fs:0], ELF_MAGIC
+    jne .fail
+    cmp byte [fs:4], 1      ; ELFCLASS32
+    jne .fail
+    cmp word [fs:18], EM_386
+    jne .fail
+    mov eax, [fs:24]
+    mov [kernel_entry], eax
+    mov ax, [fs:28]         ; e_phoff
+    mov [ph_offset], ax
+    mov ax, [fs:42]         ; e_phentsize
+    mov [ph_size], ax
+    mov cx, [fs:44]         ; e_phnum
+    mov [ph_left], cx
+    mul cx
+    add ax, [ph_offset]
+    cmp ax, 512             ; the table must be within the sector read
+    ja .fail
+
+.next_ph:
+    cmp word [ph_left], 0
+    je .done
+    mov ax, ELF_HEADER_SEG  ; a BIOS call may not preserve FS
+    mov fs, ax
+    mov si, [ph_offset]
+    cmp dword [fs:si], PT_LOAD
+    jne .skip
+
+%if KERNEL_COMPRESSED
+    mov eax, [fs:si + 12]   ; the segment must end below the buffers
+    add eax, [fs:si + 20]
+    jc .fail
+    cmp eax, KERNEL_PACKED
+    ja .fail
+%endif
+
+    mov eax, [fs:si + 4]    ; p_offset
+    mov edi, [fs:si + 12]   ; p_paddr
+    mov ecx, [fs:si + 16]   ; p_filesz
+    call load_range
+    jc .fail
+
+    mov ax, ELF_HEADER_SEG
+    mov fs, ax
+    mov si, [ph_offset]
+    mov edi, [fs:si + 12]
+    add edi, [fs:si + 16]
+    mov ecx, [fs:si + 20]   ; p_memsz
+    sub ecx, [fs:si + 16]
+    jbe .skip
+    call zero_high
+
+.skip:
+    mov ax, [ph_size]
+    add [ph_offset], ax
+    dec word [ph_left]
+    jmp .next_ph
+
+.done:
+    clc
+    ret
+.fail:
+    stc
+    ret
+
+; detect_drive: use INT 13h extensions if the boot drive has them, else
+; read its CHS geometry. CF set if neither works.
+detect_drive:
+    mov ah, 0x41            ; extensions present?
+    mov bx, 0x55AA
+    mov dl, [boot_drive]
+    int 0x13
+    jc .no_edd
+    cmp bx, 0xAA55
+    jne .no_edd
+    test cx, 0x0001         ; fixed disk access subset (AH=42h)
+    jz .no_edd
+    mov byte [use_edd], 1
+    clc
+    ret
+
+.no_edd:
+    mov ah, 0x08            ; CHS geometry
+    mov dl, [boot_drive]
+    xor di, di
+    push es
+    mov es, di
+    int 0x13
+    pop es
+    jc .fail
+    mov ax, cx
+    and ax, 0x003F
+    jz .fail
+    mov [sectors_per_track], ax
+    movzx ax, dh
+    inc ax
+    mov [head_count], ax
+    clc
+    ret
+.fail:
+    stc
+    ret
+
+%if KERNEL_COMPRESSED
+; load_range: copy ECX bytes at offset EAX of the unpacked image to linear
+; EDI. Never fails.
+load_range:
+    lea esi, [eax + KERNEL_UNPACKED]
+    call copy_high
+    clc
+    ret
+
+; ------------------------------------------
+; unpack_kernel: decode the LZ4 block at KERNEL_PACKED (KERNEL_SIZE_BYTES
+; long) into KERNEL_UNPACKED. Each sequence is a token (literal length in
+; the high nibble, match length - 4 in the low one; 15 means more length
+; bytes follow, each added until one is below 255), the literals, and a
+; 16-bit offset back into the output to copy the match from. The last
+; sequence has literals only. CF set unless exactly KERNEL_IMAGE_BYTES
+; come out.
+; ------------------------------------------
+unpack_kernel:
+    push ds
+    push es
+    call unreal
+    mov esi, KERNEL_PACKED
+    mov edi, KERNEL_UNPACKED
+
+.sequence:
+    movzx edx, byte [esi]   ; token
+    inc esi
+    mov ecx, edx
+    shr ecx, 4
+    call .length
+    a32 rep movsb           ; literals
+    cmp esi, KERNEL_PACKED + KERNEL_SIZE_BYTES
+    jae .end
+
+    movzx ebx, word [esi]   ; match offset
+    add esi, 2
+    test ebx, ebx
+    jz .corrupt
+    mov ecx, edx
+    and ecx, 0x0F
+    call .length
+    add ecx, 4
+    mov eax, edi
+    sub eax, ebx
+    cmp eax, KERNEL_UNPACKED
+    jb .corrupt
+    push esi
+    mov esi, eax            ; may overlap the output: copy byte by byte
+    a32 rep movsb
+    pop esi
+    jmp .sequence
+
+; .length: a nibble of 15 in ECX continues in the following bytes
+.length:
+    cmp ecx, 15
+    jne .length_done
+.length_byte:
+    movzx eax, byte [esi]
+    inc esi
+    add ecx, eax
+    cmp al, 255
+    je .length_byte
+.length_done:
+    ret
+
+.end:
+    cmp edi, KERNEL_UNPACKED + KERNEL_IMAGE_BYTES
+    jne .corrupt
+    clc
+    jmp .done
+.corrupt:
+    stc
+.done:
+    pop es
+    pop ds
+    ret
+%endif
+
+; read_range: copy ECX bytes at image offset EAX to linear EDI, reading
+; as many whole sectors per call as read_chunk allows. CF set on error.
+; Uncompressed, this is load_range.
+%if KERNEL_COMPRESSED == 0
+load_range:
+%endif
+read_range:
+    mov [range_offset], eax
+    mov [range_left], ecx
+    mov [next_dest], edi
+
+.next:
+    mov ecx, [range_left]
+    test ecx, ecx
+    jz .done
+    mov eax, [range_offset]
+    mov ebx, eax
+    shr eax, 9
+    add eax, [kernel_lba]
+    mov [next_lba], eax
+    and ebx, 511
+    mov [range_skip], bx
+    add ecx, ebx            ; sectors spanned by the rest of the range
+    add ecx, 511
+    shr ecx, 9
+    cmp ecx, EDD_MAX_SECTORS
+    jbe .read
+    mov cx, EDD_MAX_SECTORS
+
+.read:
+    mov bp, READ_RETRIES
+.retry:
+    push cx
+    call read_chunk         ; CX in: sectors wanted, out: sectors read
+    jnc .copy
+    pop cx
+    mov ah, 0x00            ; reset the drive and try again
+    mov dl, [boot_drive]
+    int 0x13
+    dec bp
+    jnz .retry
+    stc
+    ret
+
+.copy:
+    add sp, 2
+    movzx ecx, cx
+    shl ecx, 9
+    movzx ebx, word [range_skip]
+    sub ecx, ebx            ; bytes of the range in the bounce buffer
+    cmp ecx, [range_left]
+    jbe .copy_bytes
+    mov ecx, [range_left]
+.copy_bytes:
+    add [range_offset], ecx
+    sub [range_left], ecx
+    lea esi, [ebx + BOUNCE_LINEAR]
+    mov edi, [next_dest]
+    lea eax, [edi + ecx]
+    mov [next_dest], eax
+    call copy_high
+    jmp .next
+
+.done:
+    clc
+    ret
+
+; read_chunk: read up to CX sectors at [next_lba] into the bounce buffer.
+; Returns the count read in CX, CF set on error.
+read_chunk:
+    cmp byte [use_edd], 0
+    je .chs
+    cmp cx, EDD_MAX_SECTORS
+    jbe .edd
+    mov cx, EDD_MAX_SECTORS
+.edd:
+    mov [dap_count], cx
+    mov word [dap_offset], 0
+    mov word [dap_segment], BOUNCE_SEG
+    mov eax, [next_lba]
+    mov [dap_lba], eax
+    mov dword [dap_lba + 4], 0
+    push cx
+    mov si, dap
+    mov ah, 0x42
+    mov dl, [boot_drive]
+    int 0x13
+    pop cx
+    ret
+
+.chs:
+    ; LBA -> sector (1-based), head, cylinder; stop at the end of the track
+    push cx
+    mov eax, [next_lba]
+    xor edx, edx
+    movzx ebx, word [sectors_per_track]
+    div ebx                 ; eax = track, edx = sector index in track
+    mov di, [sectors_per_track]
+    sub di, dx              ; sectors left on this track
+    mov cl, dl
+    inc cl
+    xor edx, edx
+    movzx ebx, word [head_count]
+    div ebx                 ; eax = cylinder, edx = head
+    mov ch, al
+    shl ah, 6
+    or cl, ah               ; cylinder bits 8-9 in CL[7:6]
+    mov dh, dl
+    pop ax
+    cmp ax, di
+    jbe .count
+    mov ax, di
+.count:
+    push ax
+    push es
+    mov bx, BOUNCE_SEG
+    mov es, bx
+    xor bx, bx
+    mov ah, 0x02
+    mov dl, [boot_drive]
+    int 0x13
+    pop es
+    pop cx
+    ret
+
+; ------------------------------------------
+; unreal: reload DS and ES with base 0 and 4 GiB limits. Loading them with
+; the flat 0x10 selector in protected mode leaves 4 GiB limits in their
+; descriptor caches, which real mode keeps ("unreal mode"). Redone for
+; every copy, since a BIOS service may have reloaded them. Clobbers EAX, BX.
+; ------------------------------------------
+unreal:
+    cli
+    mov eax, cr0
+    or al, 0x01
+    mov cr0, eax
+    mov bx, 0x10
+    mov ds, bx
+    mov es, bx
+    and al, 0xFE
+    mov cr0, eax
+    xor bx, bx
+    mov ds, bx
+    mov es, bx
+    sti
+    cld
+    ret
+
+; copy_high: copy ECX bytes from linear ESI to linear EDI, anywhere in
+; the first 4 GiB, a dword at a time
+copy_high:
+    push ds
+    push es
+    call unreal
+    mov edx, ecx
+    shr ecx, 2
+    a32 rep movsd
+    mov ecx, edx
+    and ecx, 3
+    a32 rep movsb
+    pop es
+    pop ds
+    ret
+
+; zero_high: zero ECX bytes at linear EDI, a dword at a time
+zero_high:
+    push ds
+    push es
+    call unreal
+    xor eax, eax
+    mov edx, ecx
+    shr ecx, 2
+    a32 rep stosd
+    mov ecx, edx
+    and ecx, 3
+    a32 rep stosb
+    pop es
+    pop ds
+    ret
+
+%ifdef ENABLE_VESA
+; ------------------------------------------
+; setup_vesa: find a VBE_WIDTH x VBE_HEIGHT x 32bpp linear-framebuffer mode,
+; copy the BIOS 8x16 font, switch to the mode and fill the handoff block.
+; On any failure the display stays in text mode and the handoff stays clear.
+; ------------------------------------------
+setup_vesa:
+    pushad
+    push ds
+    push es
+    push fs
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+
+    ; Controller info (request the VBE 2.0+ layout)
+    mov di, VBE_CTRL_INFO
+    mov dword [di], 'VBE2'
+    mov ax, 0x4F00
+    int 0x10
+    cmp ax, 0x004F
+    jne .fail
+
+    ; Walk the mode list (far pointer at offset 14, terminated by 0xFFFF)
+    lfs si, [VBE_CTRL_INFO + 14]
+.next_mode:
+    mov cx, [fs:si]
+    cmp cx, 0xFFFF
+    je .fail
+    add si, 2
+
+    push si
+    push cx
+    mov di, VBE_MODE_INFO
+    mov ax, 0x4F01
+    int 0x10
+    pop cx
+    pop si
+    cmp ax, 0x004F
+    jne .next_mode
+
+    mov ax, [VBE_MODE_INFO + 0x00]      ; attributes: supported, graphics, LFB
+    and ax, 0x0091
+    cmp ax, 0x0091
+    jne .next_mode
+    cmp word [VBE_MODE_INFO + 0x12], VBE_WIDTH
+    jne .next_mode
+    cmp word [VBE_MODE_INFO + 0x14], VBE_HEIGHT
+    jne .next_mode
+    cmp byte [VBE_MODE_INFO + 0x19], 32
+    jne .next_mode
+
+    ; Copy the 8x16 ROM font before leaving text mode (ES:BP = font)
+    push cx
+    mov ax, 0x1130
+    mov bh, 0x06
+    int 0x10
+    push ds
+    push es
+    pop ds
+    mov si, bp
+    xor ax, ax
+    mov es, ax
+    mov di, VBE_FONT
+    mov cx, 4096 / 4
+    rep movsd
+    pop ds
+    pop bx
+
+    ; Set the mode with the linear framebuffer enabled
+    or bx, 0x4000
+    mov ax, 0x4F02
+    int 0x10
+    cmp ax, 0x004F
+    jne .fail
+
+    mov eax, [VBE_MODE_INFO + 0x28]     ; PhysBasePtr
+    mov [VBE_HANDOFF + 4], eax
+    mov ax, [VBE_MODE_INFO + 0x12]
+    mov [VBE_HANDOFF + 8], ax           ; width
+    mov ax, [VBE_MODE_INFO + 0x14]
+    mov [VBE_HANDOFF + 10], ax          ; height
+    mov ax, [VBE_MODE_INFO + 0x10]
+    mov [VBE_HANDOFF + 12], ax          ; bytes per scanline
+    mov byte [VBE_HANDOFF + 14], 32     ; bits per pixel
+    mov byte [VBE_HANDOFF + 15], 0
+    mov dword [VBE_HANDOFF + 16], VBE_FONT
+    mov dword [VBE_HANDOFF + 0], VBE_MAGIC
+    jmp .done
+
+.fail:
+    mov dword [VBE_HANDOFF], 0
+.done:
+    pop fs
+    pop es
+    pop ds
+    popad
+    ret
+%endif
+
 ; ========== GDT (Global Descriptor Table) ==========
 ; 3-entry GDT: null, code (0x08), data (0x10)
 ; Both code and data have base=0x00000000, limit=0xFFFFF (4GB with granularity=1)
@@ -209,12 +821,15 @@ pm_entry_32:
     mov gs, ax
     mov ss, ax
     ; Set a safe 32-bit stack
-    mov esp, 0x00088000
+    mov esp, KERNEL_STACK
     
     
-    ; Jump to kernel at physical 0x00090000
-    mov eax, 0x00090000
-    jmp eax
+    ; Jump to the kernel entry point (e_entry); EAX = 0 tells crt0 there
+    ; is no Multiboot information
+    mov ecx, [kernel_entry + 0x1000]
+    xor eax, eax
+    xor ebx, ebx
+    jmp ecx
     ; Unreachable, but return to 16-bit mode for NASM segment tracking
     bits 16
 
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Compress the kernel image into one raw LZ4 block for the loader.
+
+Usage: lz4_compress.py <kernel.img> <kernel.lz4>
+
+The output is a bare LZ4 block (no frame header or checksums): the loader
+knows both sizes from boot/kernel_sectors.inc and unpacks it with
+unpack_kernel in boot/loader.asm. Matches are taken greedily, the
+longest among the last MAX_CANDIDATES positions that began with the same
+four bytes; a deeper search only costs build time, never decode time. The
+result is decoded again here and compared before it is written, so a
+compressor bug fails the build rather than the boot.
+"""
+import sys
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+LAST_LITERALS = 5       # the block must end with at least 5 literals
+MF_LIMIT = 12           # and no match may start in its last 12 bytes
+MAX_CANDIDATES = 16
+
+
+def put_length(out, length):
+    """Lengths past the 4-bit token field continue in 255-valued bytes."""
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def put_sequence(out, literals, match_length, offset):
+    literal_length = len(literals)
+    token = (min(literal_length, 15) << 4)
+    if match_length:
+        token |= min(match_length - MIN_MATCH, 15)
+    out.append(token)
+    if literal_length >= 15:
+        put_length(out, literal_length - 15)
+    out += literals
+    if match_length:
+        out += offset.to_bytes(2, "little")
+        if match_length - MIN_MATCH >= 15:
+            put_length(out, match_length - MIN_MATCH - 15)
+
+
+def compress(data):
+    out = bytearray()
+    positions = {}      # first four bytes -> positions they start at, oldest first
+    anchor = pos = 0
+    match_end = len(data) - LAST_LITERALS
+
+    def remember(i):
+        positions.setdefault(data[i:i + MIN_MATCH], []).append(i)
+
+    while pos + MF_LIMIT < len(data):
+        best_length, best = 0, -1
+        for candidate in reversed(positions.get(data[pos:pos + MIN_MATCH], [])[-MAX_CANDIDATES:]):
+            if pos - candidate > MAX_OFFSET:
+                break
+            length = MIN_MATCH
+            while pos + length < match_end and data[candidate + length] == data[pos + length]:
+                length += 1
+            if length > best_length:
+                best_length, best = length, candidate
+        remember(pos)
+        if best < 0:
+            pos += 1
+            continue
+        put_sequence(out, data[anchor:pos], best_length, pos - best)
+        for i in range(pos + 1, min(pos + best_length, len(data) - MIN_MATCH)):
+            remember(i)
+        pos += best_length
+        anchor = pos
+    put_sequence(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def decompress(block):
+    """Reference decoder, the same steps as unpack_kernel."""
+    out = bytearray()
+    pos = 0
+    while True:
+        token = block[pos]
+        pos += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                extra = block[pos]
+                pos += 1
+                length += extra
+                if extra != 255:
+                    break
+        out += block[pos:pos + length]
+        pos += length
+        if pos >= len(block):
+            return bytes(out)
+        offset = int.from_bytes(block[pos:pos + 2], "little")
+        pos += 2
+        length = token & 15
+        if length == 15:
+            while True:
+                extra = block[pos]
+                pos += 1
+                length += extra
+                if extra != 255:
+                    break
+        length += MIN_MATCH
+        for _ in range(length):
+            out.append(out[-offset])
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[2], file=sys.stderr)
+        sys.exit(2)
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    block = compress(data)
+    if decompress(block) != data:
+        print("lz4_compress.py: round trip failed for %s" % sys.argv[1], file=sys.stderr)
+        sys.exit(1)
+    with open(sys.argv[2], "wb") as f:
+        f.write(block)
+    print("Compressed kernel image: %d -> %d bytes (%d%%)"
+          % (len(data), len(block), len(block) * 100 // max(len(data), 1)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Turn a 'profile dump' from the serial log into collapsed stacks.
+
+Usage: symbolize_profile.py <serial.log> [build/kernel.elf] > profile.folded
+
+The output has one "outer;...;leaf count" line per distinct stack, the
+format flamegraph.pl and speedscope read. Symbols come from `nm -n -C`, so
+no debug info is needed. Return addresses (every frame but the leaf) are
+looked up at pc-1 so a call at the end of a function is not attributed to
+the next one.
+"""
+import bisect
+import subprocess
+import sys
+
+
+def load_symbols(elf):
+    out = subprocess.run(["nm", "-n", "-C", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        parts = line.split(" ", 2)
+        if len(parts) == 3 and parts[1] in "tTwW":
+            addrs.append(int(parts[0], 16))
+            names.append(parts[2])
+    return addrs, names
+
+
+def symbolize(pc, addrs, names):
+    i = bisect.bisect_right(addrs, pc) - 1
+    return names[i] if i >= 0 else "0x%08x" % pc
+
+
+def read_dump(path):
+    """Return (header, [(count, [pc leaf-first])]) for the last dump in the log."""
+    header, stacks, inside = None, [], False
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("profile: begin"):
+                header, stacks, inside = line, [], True
+            elif line == "profile: end":
+                inside = False
+            elif inside and line:
+                fields = line.split()
+                try:
+                    stacks.append((int(fields[0]), [int(pc, 16) for pc in fields[1:]]))
+                except ValueError:
+                    pass  # a klog line that landed inside the dump
+    return header, stacks
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[2], file=sys.stderr)
+        sys.exit(2)
+    elf = sys.argv[2] if len(sys.argv) > 2 else "build/kernel.elf"
+    header, stacks = read_dump(sys.argv[1])
+    if header is None:
+        print("no 'profile: begin' block in %s" % sys.argv[1], file=sys.stderr)
+        sys.exit(1)
+
+    addrs, names = load_symbols(elf)
+    folded = {}
+    for count, pcs in stacks:
+        frames = [symbolize(pc if i == 0 else pc - 1, addrs, names) for i, pc in enumerate(pcs)]
+        key = ";".join(reversed(frames))
+        folded[key] = folded.get(key, 0) + count
+
+    for key, count in sorted(folded.items(), key=lambda kv: -kv[1]):
+        print("%s %d" % (key, count))
+    print(header, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
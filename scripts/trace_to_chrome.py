@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Turn a 'trace dump' from a raw COM1 capture into Chrome trace JSON.
+
+Usage: trace_to_chrome.py <serial.log> > trace.json
+
+Capture COM1 to a file (e.g. QEMU's -serial file:serial.log) and load the
+output in chrome://tracing or ui.perfetto.dev. The capture may hold log text
+around the dump; the last complete "RTRC" ... "RTRE" block is used. Each CPU
+is shown as one thread; timestamps are microseconds since the oldest record.
+"""
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sHHIII")
+NAME = struct.Struct("<IH")
+RECORD = struct.Struct("<QIBBH")
+VERSION = 1
+
+
+def parse(data, start):
+    """Return (header fields, {pointer: name}, [records]) or None if truncated."""
+    try:
+        magic, version, cpus, tsc_khz, name_count, record_count = HEADER.unpack_from(data, start)
+        if version != VERSION:
+            return None
+        pos = start + HEADER.size
+        names = {}
+        for _ in range(name_count):
+            pointer, length = NAME.unpack_from(data, pos)
+            pos += NAME.size
+            names[pointer] = data[pos:pos + length].decode("ascii", "replace")
+            pos += length
+        records = [RECORD.unpack_from(data, pos + i * RECORD.size) for i in range(record_count)]
+        pos += record_count * RECORD.size
+        if data[pos:pos + 4] != b"RTRE":
+            return None
+    except struct.error:
+        return None
+    return (cpus, tsc_khz), names, records
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[2], file=sys.stderr)
+        sys.exit(2)
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    dump, start = None, data.rfind(b"RTRC")
+    while start >= 0 and dump is None:
+        dump = parse(data, start)
+        start = data.rfind(b"RTRC", 0, start)
+    if dump is None:
+        print("no complete trace dump in %s" % sys.argv[1], file=sys.stderr)
+        sys.exit(1)
+
+    (cpus, tsc_khz), names, records = dump
+    if tsc_khz == 0:
+        print("dump has no TSC frequency", file=sys.stderr)
+        sys.exit(1)
+    base = min((r[0] for r in records), default=0)
+
+    events = [{"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+               "args": {"name": "CPU %d" % cpu}} for cpu in range(cpus)]
+    for tsc, pointer, kind, cpu, arg in records:
+        event = {
+            "name": names.get(pointer, "0x%08x" % pointer),
+            "ph": chr(kind),
+            "ts": (tsc - base) * 1000.0 / tsc_khz,
+            "pid": 0,
+            "tid": cpu,
+        }
+        if event["ph"] == "i":
+            event["s"] = "t"
+        if event["ph"] != "E":
+            event["args"] = {"arg": arg}
+        events.append(event)
+    events[cpus:] = sorted(events[cpus:], key=lambda e: e["ts"])
+
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, sys.stdout)
+    print("%d records from %d CPUs at %u kHz" % (len(records), cpus, tsc_khz), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,172 @@
+/*
+ * RusticOS ACPI tables
+ * --------------------
+ * Just enough ACPI to find the processors: RSDP -> RSDT -> MADT. The XSDT
+ * is ignored; on a 32-bit kernel without paging every table the RSDT
+ * points to is directly addressable anyway.
+ */
+
+#include "acpi.h"
+#include "klog.h"
+
+#define EBDA_SEGMENT_PTR   0x40E    // BDA word: EBDA segment
+#define EBDA_SEARCH_SIZE   1024
+#define BIOS_AREA_START    0xE0000
+#define BIOS_AREA_END      0x100000
+#define RSDP_ALIGN         16
+#define RSDP_V1_SIZE       20
+
+// MADT interrupt controller structure types
+#define MADT_LOCAL_APIC           0
+#define MADT_LAPIC_ADDR_OVERRIDE  5
+
+#define MADT_LAPIC_ENABLED        0x1
+#define MADT_LAPIC_ONLINE_CAPABLE 0x2
+
+struct AcpiRsdp {
+    char signature[8];          // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+} __attribute__((packed));
+
+struct AcpiSdtHeader {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+struct AcpiMadt {
+    AcpiSdtHeader header;
+    uint32_t lapic_address;
+    uint32_t flags;
+    // Variable-length interrupt controller structures follow
+} __attribute__((packed));
+
+struct MadtEntryHeader {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed));
+
+struct MadtLocalApic {
+    MadtEntryHeader header;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed));
+
+struct MadtLapicOverride {
+    MadtEntryHeader header;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed));
+
+static bool signature_equals(const char* a, const char* b, uint32_t len) {
+    for (uint32_t i = 0; i < len; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// ACPI structures are valid when all their bytes sum to zero
+static bool checksum_ok(const void* data, uint32_t len) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+static const AcpiRsdp* scan_rsdp(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start; addr + RSDP_V1_SIZE <= end; addr += RSDP_ALIGN) {
+        const AcpiRsdp* rsdp = (const AcpiRsdp*)addr;
+        if (signature_equals(rsdp->signature, "RSD PTR ", 8) && checksum_ok(rsdp, RSDP_V1_SIZE)) {
+            return rsdp;
+        }
+    }
+    return nullptr;
+}
+
+static const AcpiRsdp* find_rsdp() {
+    // Hidden from the optimizer: GCC treats pointers into the first page
+    // as null-pointer arithmetic and warns about the read
+    const volatile uint16_t* bda_word = (const volatile uint16_t*)EBDA_SEGMENT_PTR;
+    __asm__("" : "+r"(bda_word));
+    uint32_t ebda = (uint32_t)*bda_word << 4;
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        if (const AcpiRsdp* rsdp = scan_rsdp(ebda, ebda + EBDA_SEARCH_SIZE)) {
+            return rsdp;
+        }
+    }
+    return scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+}
+
+static const AcpiSdtHeader* find_table(const AcpiSdtHeader* rsdt, const char* signature) {
+    uint32_t count = (rsdt->length - sizeof(AcpiSdtHeader)) / 4;
+    const uint32_t* entries = (const uint32_t*)(rsdt + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        const AcpiSdtHeader* table = (const AcpiSdtHeader*)entries[i];
+        if (signature_equals(table->signature, signature, 4) && checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+    return nullptr;
+}
+
+bool acpi_read_madt(MadtInfo& info) {
+    info.lapic_address = 0;
+    info.cpu_count = 0;
+
+    const AcpiRsdp* rsdp = find_rsdp();
+    if (!rsdp) {
+        klog.log(LOG_INFO, "acpi: no RSDP");
+        return false;
+    }
+    const AcpiSdtHeader* rsdt = (const AcpiSdtHeader*)rsdp->rsdt_address;
+    if (!signature_equals(rsdt->signature, "RSDT", 4) || !checksum_ok(rsdt, rsdt->length)) {
+        klog.log(LOG_WARN, "acpi: bad RSDT");
+        return false;
+    }
+    const AcpiMadt* madt = (const AcpiMadt*)find_table(rsdt, "APIC");
+    if (!madt) {
+        klog.log(LOG_INFO, "acpi: no MADT");
+        return false;
+    }
+
+    info.lapic_address = madt->lapic_address;
+
+    const uint8_t* p = (const uint8_t*)(madt + 1);
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    while (p + sizeof(MadtEntryHeader) <= end) {
+        const MadtEntryHeader* entry = (const MadtEntryHeader*)p;
+        if (entry->length < sizeof(MadtEntryHeader) || p + entry->length > end) {
+            break;
+        }
+
+        if (entry->type == MADT_LOCAL_APIC) {
+            const MadtLocalApic* lapic = (const MadtLocalApic*)entry;
+            bool usable = (lapic->flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE_CAPABLE)) != 0;
+            if (usable && info.cpu_count < MADT_MAX_CPUS) {
+                info.apic_ids[info.cpu_count++] = lapic->apic_id;
+            }
+        } else if (entry->type == MADT_LAPIC_ADDR_OVERRIDE) {
+            const MadtLapicOverride* override = (const MadtLapicOverride*)entry;
+            if ((override->address >> 32) == 0) {
+                info.lapic_address = (uint32_t)override->address;
+            }
+        }
+        p += entry->length;
+    }
+
+    klog.logf(LOG_INFO, "acpi: MADT lists %u CPU(s), local APIC at %08x",
+              info.cpu_count, info.lapic_address);
+    return info.cpu_count > 0 && info.lapic_address != 0;
+}
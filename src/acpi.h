@@ -0,0 +1,26 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include "types.h"
+
+/*
+ * ACPI table discovery
+ * --------------------
+ * - Finds the RSDP in the EBDA or the BIOS area (0xE0000-0xFFFFF), follows
+ *   the RSDT and reads the MADT ("APIC") for the local APIC address and
+ *   the APIC IDs of the usable processors
+ * - Tables are read in place: memory is identity mapped and paging is off
+ */
+
+#define MADT_MAX_CPUS 16
+
+struct MadtInfo {
+    uint32_t lapic_address;
+    uint32_t cpu_count;
+    uint8_t apic_ids[MADT_MAX_CPUS];    // enabled (or online-capable) CPUs
+};
+
+// Returns false when there is no valid RSDP, RSDT or MADT
+bool acpi_read_madt(MadtInfo& info);
+
+#endif // ACPI_H
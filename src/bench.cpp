@@ -0,0 +1,334 @@
+/*
+ * RusticOS microbenchmarks
+ * ------------------------
+ * Registered benchmarks live in the BENCHMARKS table below. Each one may
+ * have an untimed setup/teardown (once) and reset (after every sample) so
+ * the timed body only contains the operation itself.
+ */
+
+#include "bench.h"
+#include "clock.h"
+#include "cpu.h"
+#include "io.h"
+#include "heap.h"
+#include "stream.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "filesystem.h"
+#include "terminal.h"
+#include "vconsole.h"
+#include "virtual_disk.h"
+#include <cstring>
+
+struct Benchmark {
+    const char* name;
+    bool (*setup)();                    // optional; false skips the benchmark
+    void (*run)(uint32_t iterations);   // timed body
+    void (*reset)();                    // optional; untimed, after each sample
+    void (*teardown)();                 // optional
+    uint32_t iterations;                // operations per sample
+};
+
+// ---------------------------------------------------------------------------
+// Serialized timestamps
+// ---------------------------------------------------------------------------
+
+// CPUID before RDTSC keeps earlier instructions from leaking into the sample
+static inline uint64_t tsc_begin() {
+    uint32_t lo, hi;
+    __asm__ __volatile__("cpuid\n\trdtsc"
+                         : "=a"(lo), "=d"(hi)
+                         : "a"(0)
+                         : "ebx", "ecx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// RDTSC then CPUID keeps later instructions from starting before the read
+static inline uint64_t tsc_end() {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc\n\t"
+                         "movl %%eax, %0\n\t"
+                         "movl %%edx, %1\n\t"
+                         "xorl %%eax, %%eax\n\t"
+                         "cpuid"
+                         : "=r"(lo), "=r"(hi)
+                         :
+                         : "eax", "ebx", "ecx", "edx", "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void compiler_barrier() {
+    __asm__ __volatile__("" : : : "memory");
+}
+
+// ---------------------------------------------------------------------------
+// Filesystem: find and create in a scratch directory
+// ---------------------------------------------------------------------------
+
+#define BENCH_DIR   ".bench"
+#define BENCH_FILES 32
+
+static char file_names[BENCH_FILES][8];
+static uint32_t heap_start;
+static uint32_t created_files;
+
+static bool fs_enter_scratch() {
+    for (uint32_t i = 0; i < BENCH_FILES; ++i) {
+        ksnprintf(file_names[i], sizeof(file_names[i]), "f%02u", i);
+    }
+    heap_start = heap_mark();
+    if (!filesystem.mkdir(BENCH_DIR)) {
+        return false;
+    }
+    filesystem.cd(BENCH_DIR);
+    created_files = 0;
+    return true;
+}
+
+static void fs_delete_created() {
+    for (uint32_t i = 0; i < created_files; ++i) {
+        filesystem.delete_file(file_names[i]);
+    }
+    created_files = 0;
+}
+
+static void fs_leave_scratch() {
+    fs_delete_created();
+    filesystem.cd("..");
+    filesystem.rmdir(BENCH_DIR);
+    heap_release(heap_start);
+}
+
+static bool fs_find_setup() {
+    if (!fs_enter_scratch()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < BENCH_FILES; ++i) {
+        filesystem.create_file(file_names[i], "");
+    }
+    created_files = BENCH_FILES;
+    return true;
+}
+
+static void fs_find_run(uint32_t iterations) {
+    // Last entry: the full linear scan
+    for (uint32_t i = 0; i < iterations; ++i) {
+        filesystem.find_file(file_names[BENCH_FILES - 1]);
+        compiler_barrier();
+    }
+}
+
+static uint32_t sample_heap;
+
+static bool fs_create_setup() {
+    if (!fs_enter_scratch()) {
+        return false;
+    }
+    sample_heap = heap_mark();
+    return true;
+}
+
+static void fs_create_run(uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; ++i) {
+        filesystem.create_file(file_names[i], "");
+    }
+    created_files = iterations;
+}
+
+static void fs_create_reset() {
+    fs_delete_created();
+    heap_release(sample_heap);
+}
+
+// ---------------------------------------------------------------------------
+// Terminal: a console that is normally not on screen
+// ---------------------------------------------------------------------------
+
+static Terminal& spare_console() {
+    return vconsoles.get(NUM_VIRTUAL_CONSOLES - 1);
+}
+
+static const char BENCH_LINE[] =
+    "The quick brown fox jumps over the lazy dog 0123456789 abcdefghijklmnopqrstu\n";
+
+static void term_write_run(uint32_t iterations) {
+    Terminal& console = spare_console();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        console.write(BENCH_LINE, sizeof(BENCH_LINE) - 1);
+    }
+}
+
+static void term_scroll_run(uint32_t iterations) {
+    Terminal& console = spare_console();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        console.scrollUp(1);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Heap, memcpy and virtual disk
+// ---------------------------------------------------------------------------
+
+static bool heap_setup() {
+    sample_heap = heap_mark();
+    return true;
+}
+
+static void heap_reset() {
+    heap_release(sample_heap);
+}
+
+static void new_run(uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; ++i) {
+        char* p = new char[64];
+        __asm__ __volatile__("" : : "r"(p) : "memory");
+    }
+}
+
+#define COPY_SIZE 4096
+static uint8_t copy_src[COPY_SIZE];
+static uint8_t copy_dst[COPY_SIZE];
+
+static void memcpy_run(uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; ++i) {
+        memcpy(copy_dst, copy_src, COPY_SIZE);
+        compiler_barrier();
+    }
+}
+
+static uint8_t sector[VDISK_SECTOR_SIZE];
+
+static void vdisk_read_run(uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; ++i) {
+        vdisk.read_sector(i & (VDISK_NUM_SECTORS - 1), sector);
+    }
+}
+
+static void vdisk_write_run(uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; ++i) {
+        vdisk.write_sector(i & (VDISK_NUM_SECTORS - 1), sector);
+    }
+}
+
+static const Benchmark BENCHMARKS[] = {
+    { "fs_find",     fs_find_setup,   fs_find_run,     nullptr,         fs_leave_scratch, 64 },
+    { "fs_create",   fs_create_setup, fs_create_run,   fs_create_reset, fs_leave_scratch, BENCH_FILES },
+    { "term_write",  nullptr,         term_write_run,  nullptr,         nullptr,          32 },
+    { "term_scroll", nullptr,         term_scroll_run, nullptr,         nullptr,          32 },
+    { "new_64",      heap_setup,      new_run,         heap_reset,      heap_reset,       64 },
+    { "memcpy_4k",   nullptr,         memcpy_run,      nullptr,         nullptr,          4 },
+    { "vdisk_read",  nullptr,         vdisk_read_run,  nullptr,         nullptr,          16 },
+    { "vdisk_write", nullptr,         vdisk_write_run, nullptr,         nullptr,          16 },
+};
+
+static const uint32_t BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+// ---------------------------------------------------------------------------
+// Harness
+// ---------------------------------------------------------------------------
+
+static uint64_t samples_buf[BENCH_MAX_SAMPLES];
+
+// Same line to the caller's stream and to COM1, for logging per build
+static void report(OutputStream& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void report(OutputStream& out, const char* fmt, ...) {
+    char line[128];
+    va_list args;
+    va_start(args, fmt);
+    int n = kvsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > (int)sizeof(line) - 1) n = sizeof(line) - 1;
+    out.write(line, (uint32_t)n);
+    serial.write(line, (uint32_t)n);
+}
+
+static void sort_samples(uint64_t* values, uint32_t count) {
+    for (uint32_t i = 1; i < count; ++i) {
+        uint64_t v = values[i];
+        uint32_t j = i;
+        while (j > 0 && values[j - 1] > v) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = v;
+    }
+}
+
+// Cost of an empty serialized bracket, subtracted from every sample
+static uint64_t measure_overhead() {
+    uint64_t best = ~0ULL;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint64_t start = tsc_begin();
+        uint64_t cycles = tsc_end() - start;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+static void run_one(OutputStream& out, const Benchmark& bench, uint32_t samples, uint64_t overhead) {
+    if (bench.setup && !bench.setup()) {
+        report(out, "%-12s skipped (setup failed)\n", bench.name);
+        return;
+    }
+
+    for (uint32_t s = 0; s < BENCH_WARMUP_SAMPLES + samples; ++s) {
+        uint32_t flags = irq_save();
+        uint64_t start = tsc_begin();
+        bench.run(bench.iterations);
+        uint64_t cycles = tsc_end() - start;
+        irq_restore(flags);
+
+        if (bench.reset) {
+            bench.reset();
+        }
+        if (s >= BENCH_WARMUP_SAMPLES) {
+            samples_buf[s - BENCH_WARMUP_SAMPLES] = (cycles > overhead) ? cycles - overhead : 0;
+        }
+    }
+
+    if (bench.teardown) {
+        bench.teardown();
+    }
+
+    sort_samples(samples_buf, samples);
+    uint32_t p99_index = (samples * 99 + 99) / 100 - 1;
+    uint64_t per_op = bench.iterations;
+    uint64_t min = samples_buf[0] / per_op;
+    uint64_t median = samples_buf[samples / 2] / per_op;
+    uint64_t p99 = samples_buf[p99_index] / per_op;
+
+    // ns/op with two decimals from the median sample
+    uint64_t centi_ns = clock_cycles_to_ns(samples_buf[samples / 2] * 100) / per_op;
+    report(out, "%-12s %10llu %10llu %10llu %8llu.%02llu\n",
+           bench.name, min, median, p99, centi_ns / 100, centi_ns % 100);
+}
+
+void bench_list(OutputStream& out) {
+    for (uint32_t i = 0; i < BENCHMARK_COUNT; ++i) {
+        kfprintf(out, "%-12s %u ops/sample\n", BENCHMARKS[i].name, BENCHMARKS[i].iterations);
+    }
+}
+
+bool bench_run(OutputStream& out, const char* name, uint32_t samples) {
+    if (!clock_has_tsc()) {
+        return false;
+    }
+    if (samples == 0) samples = BENCH_DEFAULT_SAMPLES;
+    if (samples > BENCH_MAX_SAMPLES) samples = BENCH_MAX_SAMPLES;
+
+    bool matched = false;
+    uint64_t overhead = measure_overhead();
+    for (uint32_t i = 0; i < BENCHMARK_COUNT; ++i) {
+        if (name && strcmp(name, BENCHMARKS[i].name) != 0) {
+            continue;
+        }
+        if (!matched) {
+            report(out, "bench: %u samples, TSC %u kHz, bracket %llu cycles\n",
+                   samples, clock_tsc_khz(), overhead);
+            report(out, "%-12s %10s %10s %10s %11s\n", "benchmark", "min cyc", "median", "p99", "ns/op");
+            matched = true;
+        }
+        run_one(out, BENCHMARKS[i], samples, overhead);
+    }
+    return matched;
+}
@@ -0,0 +1,29 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+
+class OutputStream;
+
+/*
+ * Microbenchmark harness
+ * ----------------------
+ * - Each registered benchmark runs `iterations` operations per sample;
+ *   a sample is bracketed by CPUID-serialized RDTSC reads with interrupts
+ *   disabled, and the cost of an empty bracket is subtracted
+ * - Warmup samples run first and are discarded
+ * - Reports min, median and p99 cycles per operation and the median in
+ *   ns/op (from the calibrated TSC), to the given stream and to COM1
+ */
+
+#define BENCH_DEFAULT_SAMPLES 64
+#define BENCH_MAX_SAMPLES     256
+#define BENCH_WARMUP_SAMPLES  4
+
+void bench_list(OutputStream& out);
+
+// Run every benchmark (name == nullptr) or the one with the given name;
+// returns false if no benchmark matched or there is no usable TSC
+bool bench_run(OutputStream& out, const char* name, uint32_t samples);
+
+#endif // BENCH_H
@@ -0,0 +1,291 @@
+/*
+ * RusticOS boot information
+ * -------------------------
+ * Both Multiboot formats are read in place (paging is off, everything is
+ * identity mapped) and copied into one BootInfo. Multiboot 1 is a fixed
+ * block whose flags say which fields are valid; Multiboot 2 is a list of
+ * 8-byte aligned tags ending in a type-0 tag.
+ */
+
+#include "bootinfo.h"
+#include "filesystem.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "stream.h"
+#include <cstring>
+
+#define MB1_BOOT_MAGIC   0x2BADB002     // EAX from a Multiboot 1 loader
+#define MB2_BOOT_MAGIC   0x36D76289     // EAX from a Multiboot 2 loader
+
+// Multiboot 1 info flags
+#define MB1_INFO_MEMORY  (1u << 0)
+#define MB1_INFO_CMDLINE (1u << 2)
+#define MB1_INFO_MODS    (1u << 3)
+#define MB1_INFO_MMAP    (1u << 6)
+#define MB1_INFO_LOADER  (1u << 9)
+
+// Multiboot 2 tag types
+#define MB2_TAG_END      0
+#define MB2_TAG_CMDLINE  1
+#define MB2_TAG_LOADER   2
+#define MB2_TAG_MODULE   3
+#define MB2_TAG_MEMINFO  4
+#define MB2_TAG_MMAP     6
+
+struct Mb1Info {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+} __attribute__((packed));
+
+struct Mb1Module {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct Mb1MmapEntry {
+    uint32_t size;              // of the rest of the entry
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed));
+
+struct Mb2Tag {
+    uint32_t type;
+    uint32_t size;
+} __attribute__((packed));
+
+struct Mb2ModuleTag {
+    Mb2Tag tag;
+    uint32_t mod_start;
+    uint32_t mod_end;
+    char string[];
+} __attribute__((packed));
+
+struct Mb2MeminfoTag {
+    Mb2Tag tag;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+} __attribute__((packed));
+
+struct Mb2MmapTag {
+    Mb2Tag tag;
+    uint32_t entry_size;
+    uint32_t entry_version;
+} __attribute__((packed));
+
+struct Mb2MmapEntry {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t reserved;
+} __attribute__((packed));
+
+// Left by crt0.s
+extern "C" uint32_t boot_magic;
+extern "C" uint32_t boot_info;
+
+static BootInfo info;
+
+static const char* const SOURCE_NAMES[] = { "boot loader", "Multiboot 1", "Multiboot 2" };
+
+static void copy_string(char* dst, uint32_t size, const char* src) {
+    uint32_t n = 0;
+    while (src && src[n] && n + 1 < size) {
+        dst[n] = src[n];
+        n++;
+    }
+    dst[n] = '\0';
+}
+
+static void add_region(uint64_t base, uint64_t length, uint32_t type) {
+    if (info.region_count < BOOT_MAX_REGIONS) {
+        BootMemoryRegion& region = info.regions[info.region_count++];
+        region.base = base;
+        region.length = length;
+        region.type = type;
+    }
+}
+
+// Module names are the last path component of the module string's first word
+static void add_module(uint32_t start, uint32_t end, const char* string) {
+    // Runs before klog is up, so extra modules are dropped silently
+    if (info.module_count >= BOOT_MAX_MODULES) {
+        return;
+    }
+    BootModule& module = info.modules[info.module_count++];
+    module.start = start;
+    module.end = end;
+
+    const char* name = string ? string : "";
+    const char* p = name;
+    while (*p && *p != ' ') {
+        if (*p == '/') name = p + 1;
+        p++;
+    }
+    uint32_t length = (uint32_t)(p - name);
+    if (length == 0) {
+        ksnprintf(module.name, sizeof(module.name), "module%u", info.module_count - 1);
+        return;
+    }
+    if (length >= sizeof(module.name)) length = sizeof(module.name) - 1;
+    memcpy(module.name, name, length);
+    module.name[length] = '\0';
+}
+
+static void parse_multiboot1(const Mb1Info* mbi) {
+    if (mbi->flags & MB1_INFO_MEMORY) {
+        info.mem_lower_kb = mbi->mem_lower;
+        info.mem_upper_kb = mbi->mem_upper;
+    }
+    if (mbi->flags & MB1_INFO_CMDLINE) {
+        copy_string(info.cmdline, sizeof(info.cmdline), (const char*)mbi->cmdline);
+    }
+    if (mbi->flags & MB1_INFO_LOADER) {
+        copy_string(info.loader_name, sizeof(info.loader_name), (const char*)mbi->boot_loader_name);
+    }
+    if (mbi->flags & MB1_INFO_MODS) {
+        const Mb1Module* mods = (const Mb1Module*)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; ++i) {
+            add_module(mods[i].mod_start, mods[i].mod_end, (const char*)mods[i].string);
+        }
+    }
+    if (mbi->flags & MB1_INFO_MMAP) {
+        uint32_t addr = mbi->mmap_addr;
+        uint32_t end = addr + mbi->mmap_length;
+        while (addr < end) {
+            const Mb1MmapEntry* entry = (const Mb1MmapEntry*)addr;
+            add_region(entry->base, entry->length, entry->type);
+            addr += entry->size + sizeof(entry->size);
+        }
+    }
+}
+
+static void parse_multiboot2(uint32_t mbi) {
+    uint32_t total_size = *(const uint32_t*)mbi;
+    uint32_t addr = mbi + 8;
+    uint32_t end = mbi + total_size;
+    while (addr + sizeof(Mb2Tag) <= end) {
+        const Mb2Tag* tag = (const Mb2Tag*)addr;
+        if (tag->type == MB2_TAG_END) {
+            break;
+        }
+        switch (tag->type) {
+        case MB2_TAG_CMDLINE:
+            copy_string(info.cmdline, sizeof(info.cmdline), (const char*)(tag + 1));
+            break;
+        case MB2_TAG_LOADER:
+            copy_string(info.loader_name, sizeof(info.loader_name), (const char*)(tag + 1));
+            break;
+        case MB2_TAG_MODULE: {
+            const Mb2ModuleTag* module = (const Mb2ModuleTag*)tag;
+            add_module(module->mod_start, module->mod_end, module->string);
+            break;
+        }
+        case MB2_TAG_MEMINFO: {
+            const Mb2MeminfoTag* meminfo = (const Mb2MeminfoTag*)tag;
+            info.mem_lower_kb = meminfo->mem_lower;
+            info.mem_upper_kb = meminfo->mem_upper;
+            break;
+        }
+        case MB2_TAG_MMAP: {
+            const Mb2MmapTag* mmap = (const Mb2MmapTag*)tag;
+            for (uint32_t entry = addr + sizeof(Mb2MmapTag); entry + sizeof(Mb2MmapEntry) <= addr + tag->size;
+                 entry += mmap->entry_size) {
+                const Mb2MmapEntry* region = (const Mb2MmapEntry*)entry;
+                add_region(region->base, region->length, region->type);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        addr += (tag->size + 7) & ~7u;
+    }
+}
+
+void bootinfo_init() {
+    if (boot_magic == MB1_BOOT_MAGIC) {
+        info.source = BOOT_SOURCE_MULTIBOOT1;
+        parse_multiboot1((const Mb1Info*)boot_info);
+    } else if (boot_magic == MB2_BOOT_MAGIC) {
+        info.source = BOOT_SOURCE_MULTIBOOT2;
+        parse_multiboot2(boot_info);
+    } else {
+        info.source = BOOT_SOURCE_LOADER;
+    }
+}
+
+const BootInfo& bootinfo() {
+    return info;
+}
+
+const char* bootinfo_source_name() {
+    return SOURCE_NAMES[info.source];
+}
+
+uint64_t bootinfo_usable_bytes() {
+    if (info.region_count == 0) {
+        return (uint64_t)(info.mem_lower_kb + info.mem_upper_kb) * 1024;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < info.region_count; ++i) {
+        if (info.regions[i].type == BOOT_MEMORY_AVAILABLE) {
+            total += info.regions[i].length;
+        }
+    }
+    return total;
+}
+
+uint32_t bootinfo_load_modules(FileSystem& fs) {
+    uint32_t loaded = 0;
+    for (uint32_t i = 0; i < info.module_count; ++i) {
+        const BootModule& module = info.modules[i];
+        uint32_t size = module.end - module.start;
+        if (!fs.find_file(module.name) && !fs.create_file(module.name, "")) {
+            klog.logf(LOG_WARN, "boot: cannot create file for module '%s'", module.name);
+            continue;
+        }
+        if (!fs.write_file(module.name, (const char*)module.start, size)) {
+            klog.logf(LOG_WARN, "boot: no room for module '%s' (%u bytes)", module.name, size);
+            continue;
+        }
+        klog.logf(LOG_INFO, "boot: module '%s' -> /%s (%u bytes)", module.name, module.name, size);
+        loaded++;
+    }
+    return loaded;
+}
+
+void bootinfo_print(OutputStream& out) {
+    kfprintf(out, "Booted by:  %s%s%s%s\n", bootinfo_source_name(),
+             info.loader_name[0] ? " (" : "", info.loader_name, info.loader_name[0] ? ")" : "");
+    kfprintf(out, "Cmdline:    %s\n", info.cmdline);
+    if (info.mem_lower_kb || info.mem_upper_kb || info.region_count) {
+        kfprintf(out, "Memory:     %u KiB usable\n", (uint32_t)(bootinfo_usable_bytes() / 1024));
+    } else {
+        kfprintf(out, "Memory:     unknown (no map from the boot loader)\n");
+    }
+    for (uint32_t i = 0; i < info.region_count; ++i) {
+        const BootMemoryRegion& region = info.regions[i];
+        kfprintf(out, "  %016llx-%016llx %s\n", region.base, region.base + region.length,
+                 region.type == BOOT_MEMORY_AVAILABLE ? "usable" : "reserved");
+    }
+    for (uint32_t i = 0; i < info.module_count; ++i) {
+        const BootModule& module = info.modules[i];
+        kfprintf(out, "Module:     %-16s %08x-%08x (%u bytes)\n", module.name, module.start, module.end,
+                 module.end - module.start);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef BOOTINFO_H
+#define BOOTINFO_H
+
+#include "types.h"
+
+class OutputStream;
+class FileSystem;
+
+/*
+ * Boot information
+ * ----------------
+ * - The kernel is entered either from boot/loader.asm (no boot information)
+ *   or by a Multiboot 1 or 2 loader: QEMU -kernel/-initrd/-append (Multiboot
+ *   1) or GRUB. crt0 keeps the magic and info pointer the loader passed
+ * - bootinfo_init() copies the command line, memory map and module list
+ *   into BootInfo before anything could overwrite the loader's structures
+ *   (up to BOOT_MAX_REGIONS regions and BOOT_MAX_MODULES modules)
+ * - Modules become files in the root directory, named after the last path
+ *   component of their first word (QEMU passes the file name), so
+ *   `-initrd init.rc` supplies the boot script
+ */
+
+#define BOOT_CMDLINE_MAX  128
+#define BOOT_NAME_MAX     32
+#define BOOT_MAX_REGIONS  32
+#define BOOT_MAX_MODULES  8
+
+#define BOOT_MEMORY_AVAILABLE 1     // Multiboot / E820 type 1
+
+enum BootSource {
+    BOOT_SOURCE_LOADER = 0,         // boot/loader.asm
+    BOOT_SOURCE_MULTIBOOT1 = 1,
+    BOOT_SOURCE_MULTIBOOT2 = 2
+};
+
+struct BootMemoryRegion {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+};
+
+struct BootModule {
+    uint32_t start;
+    uint32_t end;                   // exclusive
+    char name[BOOT_NAME_MAX];
+};
+
+struct BootInfo {
+    uint8_t source;
+    char loader_name[BOOT_NAME_MAX];
+    char cmdline[BOOT_CMDLINE_MAX];
+    uint32_t mem_lower_kb;          // 0 when the loader did not say
+    uint32_t mem_upper_kb;
+    uint32_t region_count;
+    BootMemoryRegion regions[BOOT_MAX_REGIONS];
+    uint32_t module_count;
+    BootModule modules[BOOT_MAX_MODULES];
+};
+
+// Must run before anything that allocates or uses memory above the kernel
+void bootinfo_init();
+const BootInfo& bootinfo();
+const char* bootinfo_source_name();
+
+// Bytes of BOOT_MEMORY_AVAILABLE regions (from mem_upper without a map)
+uint64_t bootinfo_usable_bytes();
+
+// Copies every module into a root directory file; returns how many
+uint32_t bootinfo_load_modules(FileSystem& fs);
+
+void bootinfo_print(OutputStream& out);
+
+#endif // BOOTINFO_H
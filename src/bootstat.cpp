@@ -0,0 +1,117 @@
+/*
+ * RusticOS boot stage timing
+ * --------------------------
+ * Marks are only taken by the boot CPU, in order, before interrupts are
+ * enabled, so the table needs no lock. It is small and fixed: a mark past
+ * BOOTSTAT_MAX_STAGES is dropped.
+ */
+
+#include "bootstat.h"
+#include "cpu.h"
+#include "clock.h"
+#include "serial.h"
+#include "kprintf.h"
+#include "stream.h"
+
+#define BOOTSTAT_LINE_MAX 80
+
+struct BootStage {
+    const char* name;
+    uint64_t tsc;                   // end of the stage
+};
+
+// Stamped by crt0.s (left at 0 without a TSC)
+extern "C" uint64_t boot_tsc_entry;
+extern "C" uint64_t boot_tsc_ctors;
+
+static BootStage stages[BOOTSTAT_MAX_STAGES];
+static uint32_t stage_count;
+static bool has_tsc;
+
+void bootstat_init() {
+    has_tsc = (cpuid_features_edx() & CPUID_EDX_TSC) != 0;
+    if (!has_tsc) {
+        return;
+    }
+    // Entry is the end of the "loader" stage, which starts at reset
+    stages[0] = { "firmware+loader", boot_tsc_entry };
+    stages[1] = { "crt0", boot_tsc_ctors };
+    stage_count = 2;
+    bootstat_mark("constructors");
+}
+
+void bootstat_mark(const char* stage) {
+    if (has_tsc && stage_count < BOOTSTAT_MAX_STAGES) {
+        stages[stage_count].name = stage;
+        stages[stage_count].tsc = rdtsc();
+        stage_count++;
+    }
+}
+
+// "12.345" milliseconds from a cycle count
+static int format_ms(char* buffer, uint32_t size, uint64_t cycles) {
+    uint32_t us = (uint32_t)(clock_cycles_to_ns(cycles) / 1000);
+    return ksnprintf(buffer, size, "%5u.%03u", us / 1000, us % 1000);
+}
+
+// Line 'i' of the table: a header, one row per stage, then the total
+static bool format_line(uint32_t i, char* line, uint32_t size) {
+    if (i == 0) {
+        ksnprintf(line, size, "%-16s %9s %9s %4s\n", "stage", "ms", "at ms", "%");
+        return true;
+    }
+    uint64_t kernel_cycles = stages[stage_count - 1].tsc - stages[0].tsc;
+    if (i <= stage_count) {
+        const BootStage& stage = stages[i - 1];
+        uint64_t start = i == 1 ? 0 : stages[i - 2].tsc;
+        uint64_t cycles = stage.tsc - start;
+        char ms[16], at[16];
+        format_ms(ms, sizeof(ms), cycles);
+        format_ms(at, sizeof(at), stage.tsc - stages[0].tsc);
+        // The loader stage is outside the kernel's share
+        uint32_t percent = i == 1 || kernel_cycles == 0 ? 0 : (uint32_t)(cycles * 100 / kernel_cycles);
+        if (i == 1) {
+            ksnprintf(line, size, "%-16s %9s %9s %4s\n", stage.name, ms, "-", "-");
+        } else {
+            ksnprintf(line, size, "%-16s %9s %9s %3u%%\n", stage.name, ms, at, percent);
+        }
+        return true;
+    }
+    if (i == stage_count + 1) {
+        char ms[16];
+        format_ms(ms, sizeof(ms), kernel_cycles);
+        ksnprintf(line, size, "%-16s %9s (kernel entry to last stage)\n", "total", ms);
+        return true;
+    }
+    return false;
+}
+
+static bool bootstat_available() {
+    return stage_count > 0 && clock_has_tsc();
+}
+
+void bootstat_print(OutputStream& out) {
+    if (!bootstat_available()) {
+        kfprintf(out, "bootstat: unavailable (no TSC)\n");
+        return;
+    }
+    char line[BOOTSTAT_LINE_MAX];
+    for (uint32_t i = 0; format_line(i, line, sizeof(line)); ++i) {
+        out.write(line);
+    }
+}
+
+void bootstat_report() {
+    if (!bootstat_available()) {
+        return;
+    }
+    // One serial write per line keeps klog output from landing mid-line
+    char line[BOOTSTAT_LINE_MAX + 10];
+    for (uint32_t i = 0; ; ++i) {
+        uint32_t n = (uint32_t)ksnprintf(line, sizeof(line), "bootstat: ");
+        if (!format_line(i, line + n, sizeof(line) - n)) {
+            break;
+        }
+        serial.write(line);
+    }
+}
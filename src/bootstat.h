@@ -0,0 +1,33 @@
+#ifndef BOOTSTAT_H
+#define BOOTSTAT_H
+
+#include "types.h"
+
+class OutputStream;
+
+/*
+ * Boot stage timing
+ * -----------------
+ * - bootstat_mark(name) stamps the TSC at the end of a boot stage; a
+ *   stage's time is the distance from the previous mark. crt0.s stamps
+ *   kernel entry and the start of the constructors itself, and
+ *   bootstat_init() turns those into the first two stages
+ * - The TSC counts from reset, so the entry stamp also gives the time
+ *   spent in the firmware, the boot sector and the loader (disk reads and
+ *   the .bss clear). Multiboot loaders are included in that figure too
+ * - Stamps are raw cycles until clock_init() has calibrated the TSC; they
+ *   are only converted when printed. Without a TSC nothing is recorded
+ * - bootstat_report() sends the table to COM1 once the kernel is ready;
+ *   the `bootstat` command prints the same table
+ */
+
+#define BOOTSTAT_MAX_STAGES 24
+
+// Call first in kernel_main, before any bootstat_mark()
+void bootstat_init();
+void bootstat_mark(const char* stage);
+
+void bootstat_print(OutputStream& out);
+void bootstat_report();             // to COM1, one write per line
+
+#endif // BOOTSTAT_H
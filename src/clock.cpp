@@ -0,0 +1,214 @@
+/*
+ * RusticOS timekeeping
+ * --------------------
+ * TSC calibration, nanosecond clock, short delays and the PIT channel 0
+ * timer interrupt. Channel 2 (the speaker channel, gated through port 0x61)
+ * is used for calibration and as the delay source on CPUs without a TSC,
+ * so it never disturbs the IRQ0 tick.
+ */
+
+#include "clock.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "io.h"
+
+// PIT ports
+#define PIT_CHANNEL0    0x40
+#define PIT_CHANNEL2    0x42
+#define PIT_COMMAND     0x43
+#define PIT_GATE_PORT   0x61    // bit 0: channel 2 gate, bit 1: speaker
+
+#define PIT_GATE2       0x01
+#define PIT_SPEAKER     0x02
+#define PIT_OUT2        0x20    // channel 2 output level (read)
+
+// Command bytes: channel, lobyte/hibyte access, mode, binary
+#define PIT_CH0_ONESHOT  0x30   // mode 0: interrupt on terminal count
+#define PIT_CH0_PERIODIC 0x34   // mode 2: rate generator
+#define PIT_CH2_ONESHOT  0xB0
+
+#define PIT_MAX_COUNT    0xFFFF
+#define CALIBRATE_MS     10
+#define CALIBRATE_COUNT  (PIT_FREQUENCY_HZ * CALIBRATE_MS / 1000)
+#define CALIBRATE_SPINS  (1u << 24)   // give up if OUT2 never rises
+
+static bool has_tsc;
+static uint32_t tsc_khz;
+static uint64_t tsc_base;
+static uint32_t ns_mult;      // ns = (cycles * ns_mult) >> ns_shift
+static uint32_t ns_shift;
+
+static volatile uint32_t ticks;
+static uint32_t tick_ns;
+static ClockTickHandler tick_handler;
+
+/**
+ * Run PIT channel 2 once for `count` input clocks with the speaker
+ * disconnected. Returns false if the output never went high.
+ */
+static bool pit2_wait(uint16_t count) {
+    uint8_t gate = inb(PIT_GATE_PORT) & ~(PIT_SPEAKER | PIT_GATE2);
+    outb(PIT_GATE_PORT, gate);
+
+    outb(PIT_COMMAND, PIT_CH2_ONESHOT);
+    outb(PIT_CHANNEL2, (uint8_t)(count & 0xFF));
+    outb(PIT_CHANNEL2, (uint8_t)(count >> 8));
+
+    // Rising gate edge starts the countdown
+    outb(PIT_GATE_PORT, gate | PIT_GATE2);
+
+    for (uint32_t spins = 0; spins < CALIBRATE_SPINS; ++spins) {
+        if (inb(PIT_GATE_PORT) & PIT_OUT2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * (cycles * mult) >> shift without a 64x64 multiply: split the cycle count
+ * into 32-bit halves so each partial product fits in 64 bits.
+ */
+static inline uint64_t mul_u64_u32_shr(uint64_t value, uint32_t mult, uint32_t shift) {
+    uint64_t low = ((uint64_t)(uint32_t)value * mult) >> shift;
+    uint64_t high = (uint64_t)(uint32_t)(value >> 32) * mult;
+    return low + (high << (32 - shift));
+}
+
+static bool calibrate_tsc() {
+    uint64_t start = rdtsc();
+    if (!pit2_wait(CALIBRATE_COUNT)) {
+        return false;
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    tsc_khz = (uint32_t)(cycles / CALIBRATE_MS);
+    if (tsc_khz == 0) {
+        return false;
+    }
+
+    // Largest shift (<= 32) whose multiplier still fits in 32 bits
+    ns_shift = 32;
+    uint64_t mult = (1000000ULL << ns_shift) / tsc_khz;
+    while (mult > 0xFFFFFFFFULL) {
+        ns_shift--;
+        mult = (1000000ULL << ns_shift) / tsc_khz;
+    }
+    ns_mult = (uint32_t)mult;
+    return true;
+}
+
+void clock_init() {
+    ticks = 0;
+    tick_ns = 0;
+    tick_handler = nullptr;
+
+    has_tsc = (cpuid_features_edx() & CPUID_EDX_TSC) != 0;
+    if (has_tsc) {
+        uint32_t flags = irq_save();
+        has_tsc = calibrate_tsc();
+        irq_restore(flags);
+    }
+    tsc_base = has_tsc ? rdtsc() : 0;
+}
+
+bool clock_has_tsc() {
+    return has_tsc;
+}
+
+uint32_t clock_tsc_khz() {
+    return tsc_khz;
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return has_tsc ? mul_u64_u32_shr(cycles, ns_mult, ns_shift) : 0;
+}
+
+uint64_t now_ns() {
+    if (has_tsc) {
+        return mul_u64_u32_shr(rdtsc() - tsc_base, ns_mult, ns_shift);
+    }
+    // Without a TSC the clock only advances with the periodic tick
+    return (uint64_t)ticks * tick_ns;
+}
+
+void udelay(uint32_t us) {
+    if (has_tsc) {
+        uint64_t deadline = rdtsc() + (uint64_t)us * tsc_khz / 1000;
+        while (rdtsc() < deadline) {
+            cpu_relax();
+        }
+        return;
+    }
+
+    // Count down PIT channel 2 in chunks of at most PIT_MAX_COUNT clocks
+    uint64_t remaining = (uint64_t)us * PIT_FREQUENCY_HZ / 1000000;
+    while (remaining > 0) {
+        uint16_t chunk = remaining > PIT_MAX_COUNT ? PIT_MAX_COUNT : (uint16_t)remaining;
+        if (!pit2_wait(chunk)) {
+            return;
+        }
+        remaining -= chunk;
+    }
+}
+
+void mdelay(uint32_t ms) {
+    while (ms > 0) {
+        uint32_t chunk = ms > 1000 ? 1000 : ms;
+        udelay(chunk * 1000);
+        ms -= chunk;
+    }
+}
+
+static void timer_irq(InterruptFrame*) {
+    ticks = ticks + 1;
+    if (tick_handler) {
+        tick_handler();
+    }
+}
+
+static uint16_t pit_divisor(uint64_t clocks) {
+    if (clocks == 0) return 1;
+    if (clocks > PIT_MAX_COUNT) return PIT_MAX_COUNT;
+    return (uint16_t)clocks;
+}
+
+void clock_start_periodic(uint32_t hz) {
+    if (hz == 0) {
+        return;
+    }
+    uint16_t divisor = pit_divisor(PIT_FREQUENCY_HZ / hz);
+    tick_ns = (uint32_t)((uint64_t)divisor * 1000000000ULL / PIT_FREQUENCY_HZ);
+
+    uint32_t flags = irq_save();
+    outb(PIT_COMMAND, PIT_CH0_PERIODIC);
+    outb(PIT_CHANNEL0, (uint8_t)(divisor & 0xFF));
+    outb(PIT_CHANNEL0, (uint8_t)(divisor >> 8));
+    irq_restore(flags);
+
+    irq_register(IRQ_TIMER, timer_irq);
+}
+
+void clock_start_oneshot(uint32_t us) {
+    uint16_t count = pit_divisor((uint64_t)us * PIT_FREQUENCY_HZ / 1000000);
+
+    uint32_t flags = irq_save();
+    outb(PIT_COMMAND, PIT_CH0_ONESHOT);
+    outb(PIT_CHANNEL0, (uint8_t)(count & 0xFF));
+    outb(PIT_CHANNEL0, (uint8_t)(count >> 8));
+    irq_restore(flags);
+
+    irq_register(IRQ_TIMER, timer_irq);
+}
+
+void clock_stop() {
+    irq_mask(IRQ_TIMER);
+}
+
+void clock_set_tick_handler(ClockTickHandler handler) {
+    tick_handler = handler;
+}
+
+uint32_t clock_ticks() {
+    return ticks;
+}
@@ -0,0 +1,38 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "types.h"
+
+/*
+ * Timekeeping
+ * -----------
+ * - clock_init() calibrates the TSC against PIT channel 2 (a fixed 10 ms
+ *   gate), so delays mean the same thing under KVM, TCG and bare metal
+ * - now_ns() is monotonic nanoseconds since clock_init(), converted from
+ *   the TSC with a fixed-point mult/shift (no division on the hot path)
+ * - udelay()/mdelay() spin on the TSC; without one they fall back to
+ *   counting down PIT channel 2
+ * - PIT channel 0 drives IRQ0, either as a periodic tick or as a one-shot
+ */
+
+#define PIT_FREQUENCY_HZ 1193182
+
+typedef void (*ClockTickHandler)();
+
+void clock_init();
+
+uint64_t now_ns();
+void udelay(uint32_t us);
+void mdelay(uint32_t ms);
+
+bool clock_has_tsc();
+uint32_t clock_tsc_khz();
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+
+void clock_start_periodic(uint32_t hz);
+void clock_start_oneshot(uint32_t us);
+void clock_stop();
+void clock_set_tick_handler(ClockTickHandler handler);
+uint32_t clock_ticks();
+
+#endif // CLOCK_H
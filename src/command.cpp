@@ -1,17 +1,28 @@
 #include "command.h"
 #include "terminal.h"
 #include "filesystem.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "filters.h"
+#include "bench.h"
+#include "kstats.h"
+#include "thread.h"
+#include "smp.h"
+#include "profile.h"
+#include "trace.h"
+#include "bootinfo.h"
+#include "bootstat.h"
+#include "clock.h"
 #include <cstring>
 
 extern Terminal terminal;
 extern FileSystem filesystem;
 
 CommandSystem::CommandSystem()
-    : input_pos(0), input_complete(false)
+    : input_pos(0), input_complete(false), console_out(terminal), out(&console_out),
+      depth(0), variable_count(0)
 {
-    for (int i = 0; i < MAX_COMMAND_LENGTH; ++i) {
-        input_buffer[i] = '\0';
-    }
+    input_buffer[0] = '\0';
     clear_command(current_command);
 }
 
@@ -40,121 +51,554 @@ void CommandSystem::process_input(char c)
     }
 }
 
+// ---------------------------------------------------------------------------
+// Command table
+// ---------------------------------------------------------------------------
+
+// grep, head and wc run first by streaming their file argument through
+// their own filter, which is exactly what cmd_cat does
+static constexpr CommandDescriptor COMMANDS[] = {
+    { "help",  &CommandSystem::cmd_help,  0, 0,        "help",                "List available commands", nullptr },
+    { "clear", &CommandSystem::cmd_clear, 0, 0,        "clear",               "Clear the screen", nullptr },
+    { "echo",  &CommandSystem::cmd_echo,  0, MAX_ARGS, "echo [text...]",      "Print text", nullptr },
+    { "mkdir", &CommandSystem::cmd_mkdir, 1, 1,        "mkdir <dir>",         "Create a directory", nullptr },
+    { "cd",    &CommandSystem::cmd_cd,    1, 1,        "cd <dir>",            "Change directory", nullptr },
+    { "ls",    &CommandSystem::cmd_ls,    0, 0,        "ls",                  "List the current directory", nullptr },
+    { "pwd",   &CommandSystem::cmd_pwd,   0, 0,        "pwd",                 "Print the working directory", nullptr },
+    { "touch", &CommandSystem::cmd_touch, 1, 1,        "touch <file>",        "Create an empty file", nullptr },
+    { "cat",   &CommandSystem::cmd_cat,   1, 1,        "cat <file> | ... | cat", "Print a file or piped input", &CommandSystem::setup_cat },
+    { "grep",  &CommandSystem::cmd_cat,   2, 2,        "grep <text> <file> | ... | grep <text>", "Print lines containing text", &CommandSystem::setup_grep },
+    { "head",  &CommandSystem::cmd_cat,   1, 2,        "head [lines] <file> | ... | head [lines]", "Print the first lines (default 10)", &CommandSystem::setup_head },
+    { "wc",    &CommandSystem::cmd_cat,   1, 1,        "wc <file> | ... | wc", "Count lines, words and bytes", &CommandSystem::setup_wc },
+    { "write", &CommandSystem::cmd_write, 2, MAX_ARGS, "write <file> <text>", "Replace a file's contents", nullptr },
+    { "dmesg", &CommandSystem::cmd_dmesg, 0, 1,        "dmesg [level]",       "Show the kernel log", nullptr },
+    { "source", &CommandSystem::cmd_source, 1, 1,      "source <file>",       "Run the commands in a file", nullptr },
+    { "sh",    &CommandSystem::cmd_source, 1, 1,       "sh <file>",           "Same as source", nullptr },
+    { "set",   &CommandSystem::cmd_set,   0, MAX_ARGS, "set [name [value]]",  "Set or list shell variables ($name)", nullptr },
+    { "unset", &CommandSystem::cmd_unset, 1, 1,        "unset <name>",        "Remove a shell variable", nullptr },
+    { "repeat", &CommandSystem::cmd_repeat, 2, MAX_ARGS, "repeat <n> <cmd...>", "Run a command n times", nullptr },
+    { "bench", &CommandSystem::cmd_bench, 0, 2,        "bench [name|all|list] [n]", "Run microbenchmarks", nullptr },
+    { "stats", &CommandSystem::cmd_stats, 0, 0,        "stats",               "Show kernel counters and gauges", nullptr },
+    { "top", &CommandSystem::cmd_top, 0, 1,            "top [interval_ms]",   "Live statistics view (q quits)", nullptr },
+    { "ps", &CommandSystem::cmd_ps, 0, 0,              "ps",                  "List kernel threads", nullptr },
+    { "profile", &CommandSystem::cmd_profile, 0, 1,    "profile [start|stop|dump]", "Sampling profiler (dump goes to COM1)", nullptr },
+    { "trace", &CommandSystem::cmd_trace, 0, 1,        "trace [start|stop|clear|dump]", "Event trace ring (dump goes to COM1)", nullptr },
+    { "bootinfo", &CommandSystem::cmd_bootinfo, 0, 0,  "bootinfo",            "Show the boot loader, memory map and modules", nullptr },
+    { "bootstat", &CommandSystem::cmd_bootstat, 0, 0,  "bootstat",            "Show how long each boot stage took", nullptr },
+    { "cpus", &CommandSystem::cmd_cpus, 0, 0,          "cpus",                "List CPUs and their scheduler counters", nullptr },
+    { "spin", &CommandSystem::cmd_spin, 0, 2,          "spin [seconds] [high|normal|low]", "Start a CPU-bound thread", nullptr },
+};
+
+static constexpr uint32_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// Perfect hash: FNV-1a of the name, mixed with a seed that is searched for
+// at compile time so that every command lands in its own slot. Lookup is
+// one hash, one slot load and one strcmp regardless of the table size.
+static constexpr uint32_t COMMAND_HASH_SLOTS = 64;      // power of two
+static constexpr uint8_t COMMAND_SLOT_EMPTY = 0xFF;
+static_assert(COMMAND_COUNT <= COMMAND_HASH_SLOTS / 2, "grow COMMAND_HASH_SLOTS");
+
+static constexpr uint32_t command_hash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+struct CommandHashTable {
+    uint32_t seed;
+    bool valid;
+    uint8_t slots[COMMAND_HASH_SLOTS];
+};
+
+static constexpr CommandHashTable build_command_hash() {
+    CommandHashTable table = {};
+    for (uint32_t seed = 0; seed < 4096; ++seed) {
+        for (uint32_t i = 0; i < COMMAND_HASH_SLOTS; ++i) {
+            table.slots[i] = COMMAND_SLOT_EMPTY;
+        }
+        bool collision = false;
+        for (uint32_t c = 0; c < COMMAND_COUNT && !collision; ++c) {
+            uint32_t slot = command_hash(COMMANDS[c].name, seed) & (COMMAND_HASH_SLOTS - 1);
+            if (table.slots[slot] != COMMAND_SLOT_EMPTY) {
+                collision = true;
+            } else {
+                table.slots[slot] = (uint8_t)c;
+            }
+        }
+        if (!collision) {
+            table.seed = seed;
+            table.valid = true;
+            return table;
+        }
+    }
+    return table;
+}
+
+static constexpr CommandHashTable COMMAND_HASH = build_command_hash();
+static_assert(COMMAND_HASH.valid, "no collision-free seed for the command table");
+
+KSTAT_COUNTER(stat_hash_probes, "shell.hash_probes");
+KSTAT_COUNTER(stat_hash_misses, "shell.hash_misses");
+
+const CommandDescriptor* CommandSystem::find(const char* name)
+{
+    kstat_inc(stat_hash_probes);
+    uint32_t slot = command_hash(name, COMMAND_HASH.seed) & (COMMAND_HASH_SLOTS - 1);
+    uint8_t index = COMMAND_HASH.slots[slot];
+    if (index == COMMAND_SLOT_EMPTY || strcmp(COMMANDS[index].name, name) != 0) {
+        kstat_inc(stat_hash_misses);
+        return nullptr;
+    }
+    return &COMMANDS[index];
+}
+
+static void report_parse_error(ParseStatus status)
+{
+    switch (status) {
+    case PARSE_UNTERMINATED_QUOTE:
+        terminal.write("Parse error: unterminated quote\n");
+        break;
+    case PARSE_TOO_MANY_ARGS:
+        kprintf("Parse error: more than %u arguments\n", MAX_ARGS);
+        break;
+    case PARSE_TOO_MANY_STAGES:
+        kprintf("Parse error: more than %u commands in a pipeline\n", MAX_PIPELINE_STAGES);
+        break;
+    case PARSE_EMPTY_STAGE:
+        terminal.write("Parse error: missing command around '|' or '>'\n");
+        break;
+    case PARSE_MISSING_REDIRECT:
+        terminal.write("Parse error: missing file name after '>'\n");
+        break;
+    case PARSE_BAD_REDIRECT:
+        terminal.write("Parse error: redirection must end the line\n");
+        break;
+    default:
+        break;
+    }
+}
+
+static void print_usage(const CommandDescriptor* command)
+{
+    terminal.write("Usage: ");
+    terminal.write(command->usage);
+    terminal.write("\n");
+}
+
 void CommandSystem::execute_command()
 {
-    parse_command(input_buffer, current_command);
-    
-    if (current_command.name[0] == '\0') {
+    run_line(input_buffer, input_pos, console_out);
+}
+
+/**
+ * Expand variables, parse and run one line of text
+ *
+ * The text is copied into a line buffer on this frame because parsing
+ * works in place and the caller's text (a script file, the input line of
+ * the command that called us) must stay intact. Nesting is bounded by
+ * MAX_SCRIPT_DEPTH so a script that sources itself cannot exhaust the stack.
+ */
+void CommandSystem::run_line(const char* line, uint32_t length, OutputStream& sink)
+{
+    if (depth >= MAX_SCRIPT_DEPTH) {
+        kprintf("Nesting deeper than %u levels\n", MAX_SCRIPT_DEPTH);
         return;
     }
-    
-    // Command dispatch
-    if (strcmp(current_command.name, "help") == 0) {
-        cmd_help();
-    } else if (strcmp(current_command.name, "clear") == 0) {
-        cmd_clear();
-    } else if (strcmp(current_command.name, "echo") == 0) {
-        cmd_echo();
-    } else if (strcmp(current_command.name, "mkdir") == 0) {
-        if (current_command.arg_count >= 1) {
-            cmd_mkdir(current_command.args[0]);
-        }
-    } else if (strcmp(current_command.name, "cd") == 0) {
-        if (current_command.arg_count >= 1) {
-            cmd_cd(current_command.args[0]);
-        }
-    } else if (strcmp(current_command.name, "ls") == 0) {
-        cmd_ls();
-    } else if (strcmp(current_command.name, "pwd") == 0) {
-        cmd_pwd();
-    } else if (strcmp(current_command.name, "touch") == 0) {
-        if (current_command.arg_count >= 1) {
-            cmd_touch(current_command.args[0]);
-        }
-    } else if (strcmp(current_command.name, "cat") == 0) {
-        if (current_command.arg_count >= 1) {
-            cmd_cat(current_command.args[0]);
-        }
-    } else if (strcmp(current_command.name, "write") == 0) {
-        if (current_command.arg_count >= 2) {
-            char content[256] = {0};
-            uint32_t pos = 0;
-            for (uint32_t ai = 1; ai < current_command.arg_count && pos < 255; ++ai) {
-                const char* part = current_command.args[ai];
-                for (uint32_t pi = 0; part[pi] && pos < 255; ++pi) {
-                    content[pos++] = part[pi];
-                }
-                if (ai + 1 < current_command.arg_count && pos < 255) {
-                    content[pos++] = ' ';
+    if (length >= MAX_COMMAND_LENGTH) {
+        kprintf("Line longer than %u characters\n", MAX_COMMAND_LENGTH - 1);
+        return;
+    }
+
+    char buffer[MAX_COMMAND_LENGTH];
+    memcpy(buffer, line, length);
+    buffer[length] = '\0';
+
+    // Lines without '$' skip the expansion copy
+    bool has_variables = false;
+    for (uint32_t i = 0; i < length && !has_variables; ++i) {
+        has_variables = (buffer[i] == '$');
+    }
+
+    char expanded[MAX_COMMAND_LENGTH];
+    char* text = buffer;
+    if (has_variables) {
+        if (!expand_variables(buffer, expanded, sizeof(expanded))) {
+            kprintf("Line longer than %u characters after expansion\n", MAX_COMMAND_LENGTH - 1);
+            return;
+        }
+        text = expanded;
+    }
+
+    Pipeline pipeline;
+    ParseStatus status = parse_line(text, pipeline);
+    if (status != PARSE_OK) {
+        report_parse_error(status);
+        return;
+    }
+    if (pipeline.stage_count == 0) {
+        return;
+    }
+
+    depth++;
+    run_pipeline(pipeline, sink);
+    depth--;
+}
+
+/**
+ * Run a parsed pipeline
+ *
+ * The chain is assembled back to front: the sink (the caller's stream or a
+ * file), then for every later stage its filter behind a bounded PipeStream.
+ * The first command then writes into the head of the chain, and closing it
+ * flushes each stage in order. All stage storage is on this stack frame.
+ * The current command and output stream are restored afterwards, so a
+ * command may run nested lines (source, repeat).
+ */
+void CommandSystem::run_pipeline(const Pipeline& pipeline, OutputStream& sink)
+{
+    // Resolve every stage before running anything
+    const CommandDescriptor* commands[MAX_PIPELINE_STAGES];
+    for (uint32_t i = 0; i < pipeline.stage_count; ++i) {
+        const StringView& name = pipeline.stages[i].name;
+        commands[i] = find(name.data);
+        if (!commands[i]) {
+            terminal.write("Unknown command: ");
+            terminal.write(name.data, name.length);
+            terminal.write("\n");
+            return;
+        }
+        if (i > 0 && !commands[i]->filter) {
+            terminal.write(name.data, name.length);
+            terminal.write(": cannot read from a pipe\n");
+            return;
+        }
+    }
+
+    const Command& first = pipeline.stages[0];
+    if (first.arg_count < commands[0]->min_args || first.arg_count > commands[0]->max_args) {
+        print_usage(commands[0]);
+        return;
+    }
+
+    FileStream file_out;
+    SharedStream shared_out(sink);
+    OutputStream* next = (pipeline.redirect.length > 0) ? (OutputStream*)&file_out : &shared_out;
+
+    PipelineStage stages[MAX_PIPELINE_STAGES];
+    for (uint32_t i = pipeline.stage_count; i-- > 0; ) {
+        if (i == 0 && !commands[0]->filter) {
+            break;
+        }
+        const Command& cmd = pipeline.stages[i];
+        uint32_t options = (i == 0) ? cmd.arg_count - 1 : cmd.arg_count;
+        OutputStream* input = (this->*(commands[i]->filter))(cmd, options, stages[i], *next);
+        if (!input) {
+            print_usage(commands[i]);
+            return;
+        }
+        if (i == 0) {
+            next = input;
+        } else {
+            stages[i].pipe.connect(input);
+            next = &stages[i].pipe;
+        }
+    }
+
+    // Only touch the target file once the whole line is known to be valid
+    if (pipeline.redirect.length > 0 && !file_out.open(pipeline.redirect.data, pipeline.append)) {
+        terminal.write("Cannot open ");
+        terminal.write(pipeline.redirect.data, pipeline.redirect.length);
+        terminal.write("\n");
+        return;
+    }
+
+    Command saved_command = current_command;
+    OutputStream* saved_out = out;
+
+    current_command = first;
+    out = next;
+    {
+        TRACE_SCOPE(commands[0]->name, pipeline.stage_count);
+        (this->*(commands[0]->handler))();
+        out->close();
+    }
+
+    current_command = saved_command;
+    out = saved_out;
+}
+
+bool CommandSystem::run_script(const char* name, OutputStream& sink)
+{
+    const FileNode* file = filesystem.find_file(name);
+    if (!file) {
+        return false;
+    }
+
+    // Lines are run straight from the file contents; each one is copied
+    // into its own line buffer by run_line
+    const char* data = file->data;
+    uint32_t size = file->size;
+    uint32_t start = 0;
+    while (start < size) {
+        uint32_t end = start;
+        while (end < size && data[end] != '\n') end++;
+
+        uint32_t length = end - start;
+        if (length > 0 && data[start + length - 1] == '\r') length--;
+
+        // Skip blank lines and # comments
+        uint32_t first = start;
+        while (first < start + length && (data[first] == ' ' || data[first] == '\t')) first++;
+        if (first < start + length && data[first] != '#') {
+            run_line(data + start, length, sink);
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Shell variables
+// ---------------------------------------------------------------------------
+
+static bool parse_count(const char* text, uint32_t& value) {
+    value = 0;
+    if (!*text) return false;
+    for (; *text; ++text) {
+        if (*text < '0' || *text > '9') return false;
+        value = value * 10 + (uint32_t)(*text - '0');
+    }
+    return true;
+}
+
+static inline bool is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+ShellVariable* CommandSystem::find_variable(const char* name, uint32_t length)
+{
+    for (uint32_t i = 0; i < variable_count; ++i) {
+        const char* candidate = variables[i].name;
+        uint32_t n = 0;
+        while (n < length && candidate[n] == name[n]) n++;
+        if (n == length && candidate[n] == '\0') {
+            return &variables[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Replace $name and ${name} with variable values (unset names expand to
+ * nothing). Text inside single quotes and \$ are left alone; the result
+ * is parsed afterwards, so values containing blanks become several words.
+ *
+ * @return false if the result does not fit in `capacity`
+ */
+bool CommandSystem::expand_variables(const char* input, char* output, uint32_t capacity)
+{
+    uint32_t pos = 0;
+    bool single = false;
+    bool dquote = false;
+
+    for (const char* p = input; *p; ) {
+        char c = *p;
+        if (c == '\\' && !single && p[1]) {
+            if (pos + 2 >= capacity) return false;
+            output[pos++] = *p++;
+            output[pos++] = *p++;
+            continue;
+        }
+        if (c == '\'' && !dquote) single = !single;
+        if (c == '"' && !single) dquote = !dquote;
+
+        if (c == '$' && !single && (is_name_char(p[1]) || p[1] == '{')) {
+            bool braced = (p[1] == '{');
+            const char* name = p + (braced ? 2 : 1);
+            uint32_t length = 0;
+            while (is_name_char(name[length])) length++;
+            if (!braced || name[length] == '}') {
+                ShellVariable* var = find_variable(name, length);
+                if (var) {
+                    uint32_t value_length = strlen(var->value);
+                    if (pos + value_length >= capacity) return false;
+                    memcpy(output + pos, var->value, value_length);
+                    pos += value_length;
                 }
+                p = name + length + (braced ? 1 : 0);
+                continue;
             }
-            content[pos] = '\0';
-            cmd_write(current_command.args[0], content);
         }
-    } else {
-        terminal.write("Unknown command: ");
-        terminal.write(current_command.name);
-        terminal.write("\n");
+
+        if (pos + 1 >= capacity) return false;
+        output[pos++] = *p++;
     }
+    output[pos] = '\0';
+    return true;
 }
 
 void CommandSystem::reset_input()
 {
+    // Only the terminator matters; parse_line never reads past it
     input_pos = 0;
     input_complete = false;
-    for (int i = 0; i < MAX_COMMAND_LENGTH; ++i) {
-        input_buffer[i] = '\0';
-    }
+    input_buffer[0] = '\0';
     clear_command(current_command);
 }
 
-void CommandSystem::parse_command(const char* input, Command& cmd)
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline bool is_operator(char c) {
+    return c == '|' || c == '>';
+}
+
+/**
+ * Split the input line into commands and tokens in a single pass, in place
+ *
+ * - Blanks separate tokens; "double" and 'single' quotes group them, and
+ *   quoted and unquoted parts of one word are joined (a"b c" -> ab c)
+ * - Inside double quotes \n, \t, \" and \\ are escapes; outside quotes a
+ *   backslash takes the next character literally. Single quotes are raw
+ * - Unquoted '|' starts the next command; '>' / '>>' name the output file
+ *   and must come last. Neither needs surrounding blanks
+ * - Unescaping only ever shrinks a token, so it is written back over the
+ *   input, and each token gets a NUL in place of its delimiter
+ *
+ * Command names and arguments are views into `input`; nothing is copied
+ * and there is no per-argument length limit.
+ */
+ParseStatus CommandSystem::parse_line(char* input, Pipeline& line)
 {
-    clear_command(cmd);
-    
-    uint32_t i = 0;
-    uint32_t arg_index = 0;
-    
-    // Parse command name
-    uint32_t np = 0;
-    while (input[i] && input[i] != ' ' && np < 63) {
-        cmd.name[np++] = input[i++];
-    }
-    cmd.name[np] = '\0';
-    
-    // Skip spaces
-    while (input[i] == ' ') i++;
-    
-    // Parse arguments
-    while (input[i] && arg_index < MAX_ARGS) {
-        uint32_t ap = 0;
-        while (input[i] && input[i] != ' ' && ap < 63) {
-            cmd.args[arg_index][ap++] = input[i++];
+    line.stage_count = 0;
+    line.redirect.data = "";
+    line.redirect.length = 0;
+    line.append = false;
+
+    Command* cmd = nullptr;         // command collecting words, if any
+    bool want_target = false;       // last token was > or >>
+    char* read = input;
+
+    for (;;) {
+        while (is_blank(*read)) read++;
+        char op = *read;
+
+        if (op != '\0' && !is_operator(op)) {
+            char* start = read;
+            char* write = read;
+            char quote = 0;
+            while (*read && (quote || (!is_blank(*read) && !is_operator(*read)))) {
+                char c = *read++;
+                if (quote == '\'') {
+                    if (c == '\'') quote = 0;
+                    else *write++ = c;
+                } else if (quote == '"') {
+                    if (c == '"') {
+                        quote = 0;
+                    } else if (c == '\\' && *read) {
+                        char e = *read++;
+                        *write++ = (e == 'n') ? '\n' : (e == 't') ? '\t' : e;
+                    } else {
+                        *write++ = c;
+                    }
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == '\\' && *read) {
+                    *write++ = *read++;
+                } else {
+                    *write++ = c;
+                }
+            }
+            if (quote) {
+                return PARSE_UNTERMINATED_QUOTE;
+            }
+
+            // The terminator may land on the delimiter, so remember it first
+            op = *read;
+            *write = '\0';
+            StringView token = { start, (uint32_t)(write - start) };
+
+            if (want_target) {
+                line.redirect = token;
+                want_target = false;
+            } else if (line.redirect.length > 0) {
+                return PARSE_BAD_REDIRECT;
+            } else if (!cmd) {
+                if (line.stage_count == MAX_PIPELINE_STAGES) {
+                    return PARSE_TOO_MANY_STAGES;
+                }
+                cmd = &line.stages[line.stage_count++];
+                clear_command(*cmd);
+                cmd->name = token;
+            } else {
+                if (cmd->arg_count == MAX_ARGS) {
+                    return PARSE_TOO_MANY_ARGS;
+                }
+                cmd->args[cmd->arg_count++] = token;
+            }
+
+            if (is_blank(op)) {
+                read++;
+                continue;
+            }
+        }
+
+        if (op == '\0') {
+            break;
+        }
+
+        // Operator: '|', '>' or '>>'
+        read++;
+        if (want_target) {
+            return PARSE_MISSING_REDIRECT;
+        }
+        if (line.redirect.length > 0) {
+            return PARSE_BAD_REDIRECT;
         }
-        cmd.args[arg_index][ap] = '\0';
-        
-        if (ap > 0) {
-            arg_index++;
+        if (!cmd) {
+            return PARSE_EMPTY_STAGE;
+        }
+        if (op == '|') {
+            cmd = nullptr;
+        } else {
+            if (*read == '>') {
+                line.append = true;
+                read++;
+            }
+            want_target = true;
         }
-        
-        while (input[i] == ' ') i++;
     }
-    
-    cmd.arg_count = arg_index;
+
+    if (want_target) {
+        return PARSE_MISSING_REDIRECT;
+    }
+    if (!cmd && line.stage_count > 0) {
+        return PARSE_EMPTY_STAGE;     // trailing '|'
+    }
+    return PARSE_OK;
 }
 
 void CommandSystem::clear_command(Command& cmd)
 {
-    cmd.name[0] = '\0';
+    cmd.name.data = "";
+    cmd.name.length = 0;
     cmd.arg_count = 0;
-    for (int i = 0; i < MAX_ARGS; ++i) {
-        cmd.args[i][0] = '\0';
-    }
 }
 
-// Stub implementations
+// ---------------------------------------------------------------------------
+// Command implementations
+// ---------------------------------------------------------------------------
+
 void CommandSystem::cmd_help() {
-    terminal.write("Available commands: help, clear, echo, mkdir, cd, ls, pwd, touch, cat, write\n");
+    out->write("Available commands:\n");
+    for (uint32_t i = 0; i < COMMAND_COUNT; ++i) {
+        kfprintf(*out, "  %-20s %s\n", COMMANDS[i].usage, COMMANDS[i].help);
+    }
+    out->write("Commands can be chained with '|' and redirected with > or >>\n");
 }
 
 void CommandSystem::cmd_clear() {
@@ -162,45 +606,338 @@ void CommandSystem::cmd_clear() {
 }
 
 void CommandSystem::cmd_echo() {
-    if (current_command.arg_count > 0) {
-        for (uint32_t i = 0; i < current_command.arg_count; ++i) {
-            terminal.write(current_command.args[i]);
-            if (i + 1 < current_command.arg_count) terminal.write(" ");
-        }
+    for (uint32_t i = 0; i < current_command.arg_count; ++i) {
+        const StringView& text = current_command.args[i];
+        out->write(text.data, text.length);
+        if (i + 1 < current_command.arg_count) out->write(" ");
     }
-    terminal.write("\n");
+    out->write("\n");
 }
 
-void CommandSystem::cmd_mkdir(const char* name) {
-    filesystem.mkdir(name);
+void CommandSystem::cmd_mkdir() {
+    filesystem.mkdir(arg(0));
 }
 
-void CommandSystem::cmd_cd(const char* path) {
-    filesystem.cd(path);
+void CommandSystem::cmd_cd() {
+    filesystem.cd(arg(0));
 }
 
 void CommandSystem::cmd_ls() {
-    filesystem.ls();
+    filesystem.ls(*out);
 }
 
 void CommandSystem::cmd_pwd() {
-    filesystem.pwd();
+    filesystem.pwd(*out);
 }
 
-void CommandSystem::cmd_touch(const char* name) {
-    filesystem.create_file(name, "");
+void CommandSystem::cmd_touch() {
+    filesystem.create_file(arg(0), "");
 }
 
-void CommandSystem::cmd_cat(const char* name) {
-    char buffer[512] = {0};
-    if (filesystem.read_file(name, buffer, 511)) {
-        terminal.write(buffer);
+void CommandSystem::cmd_cat() {
+    // The file is the last argument (grep/head/wc put their options first)
+    const char* name = arg(current_command.arg_count - 1);
+    const FileNode* file = filesystem.find_file(name);
+    if (!file) {
+        terminal.write("No such file: ");
+        terminal.write(name);
         terminal.write("\n");
+        return;
+    }
+
+    out->write(file->data, file->size);
+
+    // Keep the prompt on its own line when printing straight to the console
+    if (out == &console_out && file->size > 0 && file->data[file->size - 1] != '\n') {
+        out->write("\n");
     }
 }
 
-void CommandSystem::cmd_write(const char* name, const char* content) {
-    filesystem.write_file(name, content);
+void CommandSystem::cmd_write() {
+    // Unquoted words are written back with single spaces between them
+    const char* name = arg(0);
+    const StringView& first = current_command.args[1];
+    if (!filesystem.write_file(name, first.data, first.length)) {
+        return;
+    }
+    for (uint32_t i = 2; i < current_command.arg_count; ++i) {
+        const StringView& part = current_command.args[i];
+        filesystem.append_file(name, " ", 1);
+        filesystem.append_file(name, part.data, part.length);
+    }
+}
+
+void CommandSystem::cmd_dmesg() {
+    const char* level = current_command.arg_count >= 1 ? arg(0) : nullptr;
+    uint8_t min_level = LOG_DEBUG;
+    if (level) {
+        for (uint8_t l = LOG_DEBUG; l <= LOG_ERROR; ++l) {
+            const char* name = KernelLog::level_name(l);
+            uint32_t i = 0;
+            // Case-insensitive match against DEBUG/INFO/WARN/ERROR
+            while (name[i] && (level[i] | 0x20) == (name[i] | 0x20)) i++;
+            if (name[i] == '\0' && level[i] == '\0') {
+                min_level = l;
+                break;
+            }
+        }
+    }
+    klog.dump(*out, min_level);
+}
+
+void CommandSystem::cmd_source() {
+    if (!run_script(arg(0), *out)) {
+        terminal.write("No such file: ");
+        terminal.write(arg(0));
+        terminal.write("\n");
+    }
+}
+
+void CommandSystem::cmd_set() {
+    if (current_command.arg_count == 0) {
+        for (uint32_t i = 0; i < variable_count; ++i) {
+            kfprintf(*out, "%s=%s\n", variables[i].name, variables[i].value);
+        }
+        return;
+    }
+
+    const StringView& name = current_command.args[0];
+    for (uint32_t i = 0; i < name.length; ++i) {
+        if (!is_name_char(name.data[i])) {
+            terminal.write("set: names use letters, digits and _\n");
+            return;
+        }
+    }
+    if (name.length >= MAX_VARIABLE_NAME) {
+        kprintf("set: names are limited to %u characters\n", MAX_VARIABLE_NAME - 1);
+        return;
+    }
+
+    ShellVariable* var = find_variable(name.data, name.length);
+    if (!var) {
+        if (variable_count == MAX_VARIABLES) {
+            terminal.write("set: too many variables\n");
+            return;
+        }
+        var = &variables[variable_count++];
+        memcpy(var->name, name.data, name.length);
+        var->name[name.length] = '\0';
+    }
+
+    // Value: the remaining words joined by single spaces
+    uint32_t pos = 0;
+    for (uint32_t i = 1; i < current_command.arg_count; ++i) {
+        const StringView& word = current_command.args[i];
+        if (i > 1 && pos < MAX_VARIABLE_VALUE - 1) var->value[pos++] = ' ';
+        uint32_t n = word.length;
+        if (n > MAX_VARIABLE_VALUE - 1 - pos) n = MAX_VARIABLE_VALUE - 1 - pos;
+        memcpy(var->value + pos, word.data, n);
+        pos += n;
+    }
+    var->value[pos] = '\0';
+}
+
+void CommandSystem::cmd_unset() {
+    const StringView& name = current_command.args[0];
+    ShellVariable* var = find_variable(name.data, name.length);
+    if (var) {
+        *var = variables[--variable_count];
+    }
+}
+
+void CommandSystem::cmd_repeat() {
+    uint32_t count;
+    if (!parse_count(arg(0), count)) {
+        terminal.write("Usage: repeat <n> <cmd...>\n");
+        return;
+    }
+
+    // Re-run the already parsed words as a one-stage pipeline; its output
+    // goes wherever repeat's own output goes (so `repeat 3 ls | wc` works)
+    Pipeline body;
+    body.stage_count = 1;
+    body.redirect.data = "";
+    body.redirect.length = 0;
+    body.append = false;
+    Command& cmd = body.stages[0];
+    cmd.name = current_command.args[1];
+    cmd.arg_count = current_command.arg_count - 2;
+    for (uint32_t i = 0; i < cmd.arg_count; ++i) {
+        cmd.args[i] = current_command.args[i + 2];
+    }
+
+    if (depth >= MAX_SCRIPT_DEPTH) {
+        kprintf("Nesting deeper than %u levels\n", MAX_SCRIPT_DEPTH);
+        return;
+    }
+    depth++;
+    for (uint32_t i = 0; i < count; ++i) {
+        run_pipeline(body, *out);
+        // Let background threads run between iterations
+        thread_yield();
+    }
+    depth--;
+}
+
+void CommandSystem::cmd_bench() {
+    const char* name = current_command.arg_count >= 1 ? arg(0) : "all";
+    if (strcmp(name, "list") == 0) {
+        bench_list(*out);
+        return;
+    }
+
+    uint32_t samples = BENCH_DEFAULT_SAMPLES;
+    if (current_command.arg_count == 2 && (!parse_count(arg(1), samples) || samples == 0)) {
+        terminal.write("Usage: bench [name|all|list] [samples]\n");
+        return;
+    }
+    if (samples > BENCH_MAX_SAMPLES) {
+        samples = BENCH_MAX_SAMPLES;
+    }
+
+    if (!bench_run(*out, strcmp(name, "all") == 0 ? nullptr : name, samples)) {
+        kprintf("bench: no benchmark '%s' or no usable TSC (see 'bench list')\n", name);
+    }
+}
+
+void CommandSystem::cmd_stats() {
+    kstats_print(*out);
+}
+
+void CommandSystem::cmd_ps() {
+    threads_print(*out);
+}
+
+void CommandSystem::cmd_cpus() {
+    smp_print(*out);
+}
+
+void CommandSystem::cmd_bootinfo() {
+    bootinfo_print(*out);
+}
+
+void CommandSystem::cmd_bootstat() {
+    bootstat_print(*out);
+}
+
+void CommandSystem::cmd_profile() {
+    const char* action = current_command.arg_count >= 1 ? arg(0) : "status";
+    if (strcmp(action, "start") == 0) {
+        profile_start();
+        kfprintf(*out, "profile: sampling at %u Hz per CPU\n", SCHED_TICK_HZ);
+    } else if (strcmp(action, "stop") == 0) {
+        profile_stop();
+        profile_status(*out);
+    } else if (strcmp(action, "dump") == 0) {
+        profile_dump(*out);
+    } else if (strcmp(action, "status") == 0) {
+        profile_status(*out);
+    } else {
+        terminal.write("Usage: profile [start|stop|dump]\n");
+    }
+}
+
+void CommandSystem::cmd_trace() {
+    const char* action = current_command.arg_count >= 1 ? arg(0) : "status";
+    if (strcmp(action, "start") == 0) {
+        trace_start();
+        trace_status(*out);
+    } else if (strcmp(action, "stop") == 0) {
+        trace_stop();
+        trace_status(*out);
+    } else if (strcmp(action, "clear") == 0) {
+        trace_stop();
+        trace_clear();
+        trace_status(*out);
+    } else if (strcmp(action, "dump") == 0) {
+        trace_dump(*out);
+    } else if (strcmp(action, "status") == 0) {
+        trace_status(*out);
+    } else {
+        terminal.write("Usage: trace [start|stop|clear|dump]\n");
+    }
+}
+
+// Body of a 'spin' thread: burn CPU until the deadline passed in arg
+static void spin_thread(void* arg) {
+    uint64_t deadline = now_ns() + (uint64_t)(uint32_t)arg * 1000000000ULL;
+    uint32_t rounds = 0;
+    while (now_ns() < deadline) {
+        for (volatile uint32_t i = 0; i < 1000; ++i) {
+        }
+        rounds++;
+    }
+    klog.logf(LOG_INFO, "spin: thread %u done after %u rounds", thread_current()->id, rounds);
+}
+
+void CommandSystem::cmd_spin() {
+    uint32_t seconds = 10;
+    if (current_command.arg_count >= 1 && !parse_count(arg(0), seconds)) {
+        terminal.write("Usage: spin [seconds] [high|normal|low]\n");
+        return;
+    }
+
+    ThreadPriority priority = PRIORITY_LOW;
+    if (current_command.arg_count == 2) {
+        if (strcmp(arg(1), "high") == 0) {
+            priority = PRIORITY_HIGH;
+        } else if (strcmp(arg(1), "normal") == 0) {
+            priority = PRIORITY_NORMAL;
+        } else if (strcmp(arg(1), "low") != 0) {
+            terminal.write("Usage: spin [seconds] [high|normal|low]\n");
+            return;
+        }
+    }
+
+    Thread* thread = thread_create("spin", spin_thread, (void*)seconds, priority);
+    if (!thread) {
+        terminal.write("spin: no free thread slots\n");
+        return;
+    }
+    kfprintf(*out, "spin: thread %u for %u s\n", thread->id, seconds);
+}
+
+void CommandSystem::cmd_top() {
+    uint32_t interval_ms = 1000;
+    if (current_command.arg_count == 1 && (!parse_count(arg(0), interval_ms) || interval_ms < 100)) {
+        terminal.write("Usage: top [interval_ms] (at least 100)\n");
+        return;
+    }
+    kstats_top(interval_ms);
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline filters
+// ---------------------------------------------------------------------------
+
+OutputStream* CommandSystem::setup_cat(const Command&, uint32_t options, PipelineStage&, OutputStream& next) {
+    // Piped input passes straight through
+    return options == 0 ? &next : nullptr;
+}
+
+OutputStream* CommandSystem::setup_grep(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next) {
+    if (options != 1) {
+        return nullptr;
+    }
+    stage.grep.start(&next, cmd.args[0].data);
+    return &stage.grep;
+}
+
+OutputStream* CommandSystem::setup_head(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next) {
+    uint32_t lines = 10;
+    if (options > 1 || (options == 1 && !parse_count(cmd.args[0].data, lines))) {
+        return nullptr;
+    }
+    stage.head.start(&next, lines);
+    return &stage.head;
+}
+
+OutputStream* CommandSystem::setup_wc(const Command&, uint32_t options, PipelineStage& stage, OutputStream& next) {
+    if (options != 0) {
+        return nullptr;
+    }
+    stage.wc.start(&next);
+    return &stage.wc;
 }
 
 CommandSystem command_system;
@@ -2,25 +2,97 @@
 #define COMMAND_H
 
 #include "types.h"
+#include "stream.h"
 
 #define MAX_COMMAND_LENGTH 256
 #define MAX_ARGS 16
+#define MAX_PIPELINE_STAGES 4
+#define MAX_SCRIPT_DEPTH 4          // nested source/repeat levels
+#define MAX_VARIABLES 16
+#define MAX_VARIABLE_NAME 16
+#define MAX_VARIABLE_VALUE 128
+
+// A token inside the input buffer. The tokenizer NUL-terminates every token
+// in place, so `data` can also be used as a C string.
+struct StringView {
+    const char* data;
+    uint32_t length;
+};
 
 struct Command {
-    char name[64];
-    char args[MAX_ARGS][64];
+    StringView name;
+    StringView args[MAX_ARGS];
     uint32_t arg_count;
 };
 
+// One input line: commands joined by '|', optionally ending in > or >> file
+struct Pipeline {
+    Command stages[MAX_PIPELINE_STAGES];
+    uint32_t stage_count;
+    StringView redirect;    // target file, length 0 when output is the console
+    bool append;            // >> rather than >
+};
+
+enum ParseStatus {
+    PARSE_OK,
+    PARSE_UNTERMINATED_QUOTE,
+    PARSE_TOO_MANY_ARGS,
+    PARSE_TOO_MANY_STAGES,
+    PARSE_EMPTY_STAGE,
+    PARSE_MISSING_REDIRECT,
+    PARSE_BAD_REDIRECT
+};
+
+struct ShellVariable {
+    char name[MAX_VARIABLE_NAME];
+    char value[MAX_VARIABLE_VALUE];
+};
+
+class CommandSystem;
+struct PipelineStage;
+
+// Every handler reads its arguments from the parsed current command and
+// writes its output to the current output stream
+typedef void (CommandSystem::*CommandHandler)();
+
+// Prepares a command to read piped input: returns the stream the previous
+// stage should write into, or nullptr if the options are invalid. `options`
+// excludes the trailing file argument when the command runs first.
+typedef OutputStream* (CommandSystem::*FilterSetup)(const Command& cmd, uint32_t options,
+                                                     PipelineStage& stage, OutputStream& next);
+
+/*
+ * One shell command. The table of descriptors in command.cpp drives both
+ * dispatch (through a perfect hash built at compile time) and `help`.
+ */
+struct CommandDescriptor {
+    const char* name;
+    CommandHandler handler;
+    uint8_t min_args;
+    uint8_t max_args;
+    const char* usage;
+    const char* help;
+    FilterSetup filter;     // non-null if the command can follow a '|'
+};
+
 class CommandSystem {
 private:
     char input_buffer[MAX_COMMAND_LENGTH];
     uint32_t input_pos;
     bool input_complete;
     Command current_command;
+    TerminalStream console_out;
+    OutputStream* out;                  // where command output goes
+    uint32_t depth;                     // nesting of run_line calls
+    ShellVariable variables[MAX_VARIABLES];
+    uint32_t variable_count;
     
-    void parse_command(const char* input, Command& cmd);
+    ParseStatus parse_line(char* input, Pipeline& line);
+    void run_pipeline(const Pipeline& line, OutputStream& sink);
+    bool expand_variables(const char* input, char* output, uint32_t capacity);
+    ShellVariable* find_variable(const char* name, uint32_t length);
     void clear_command(Command& cmd);
+    const char* arg(uint32_t index) const { return current_command.args[index].data; }
     
 public:
     CommandSystem();
@@ -28,22 +100,51 @@ public:
     void process_input(char c);
     void execute_command();
     void reset_input();
+
+    // Run one line of text as if typed (without echo), or every line of a
+    // file; output goes to `sink`, which is left open
+    void run_line(const char* line, uint32_t length, OutputStream& sink);
+    bool run_script(const char* name, OutputStream& sink);
+    bool run_script(const char* name) { return run_script(name, console_out); }
     
     bool is_input_complete() const { return input_complete; }
     const char* get_input_buffer() const { return input_buffer; }
     uint32_t get_input_pos() const { return input_pos; }
+
+    static const CommandDescriptor* find(const char* name);
     
-    // Command implementations
+    // Command implementations (arguments come from current_command)
     void cmd_help();
     void cmd_clear();
     void cmd_echo();
-    void cmd_mkdir(const char* name);
-    void cmd_cd(const char* path);
+    void cmd_mkdir();
+    void cmd_cd();
     void cmd_ls();
     void cmd_pwd();
-    void cmd_touch(const char* name);
-    void cmd_cat(const char* name);
-    void cmd_write(const char* name, const char* content);
+    void cmd_touch();
+    void cmd_cat();
+    void cmd_write();
+    void cmd_dmesg();
+    void cmd_source();
+    void cmd_set();
+    void cmd_unset();
+    void cmd_repeat();
+    void cmd_bench();
+    void cmd_stats();
+    void cmd_top();
+    void cmd_ps();
+    void cmd_cpus();
+    void cmd_bootinfo();
+    void cmd_bootstat();
+    void cmd_profile();
+    void cmd_trace();
+    void cmd_spin();
+
+    // Pipeline filter setup (see FilterSetup)
+    OutputStream* setup_cat(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next);
+    OutputStream* setup_grep(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next);
+    OutputStream* setup_head(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next);
+    OutputStream* setup_wc(const Command& cmd, uint32_t options, PipelineStage& stage, OutputStream& next);
 };
 
 extern CommandSystem command_system;
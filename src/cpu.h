@@ -0,0 +1,78 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+/*
+ * CPU feature detection and control-register helpers.
+ */
+
+#define CPUID_EDX_TSC   (1u << 4)
+#define CPUID_EDX_FXSR  (1u << 24)
+#define CPUID_EDX_SSE   (1u << 25)
+#define CPUID_EDX_SSE2  (1u << 26)
+
+#define CR0_MP          (1u << 1)
+#define CR0_EM          (1u << 2)
+#define CR4_OSFXSR      (1u << 9)
+#define CR4_OSXMMEXCPT  (1u << 10)
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ __volatile__("cpuid"
+                         : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                         : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t cpuid_features_edx() {
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    return d;
+}
+
+/**
+ * Read the time-stamp counter
+ */
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void cpu_relax() {
+    __asm__ __volatile__("pause" : : : "memory");
+}
+
+static inline uint32_t read_cr0() {
+    uint32_t v;
+    __asm__ __volatile__("movl %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ __volatile__("movl %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline uint32_t read_cr4() {
+    uint32_t v;
+    __asm__ __volatile__("movl %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr4(uint32_t v) {
+    __asm__ __volatile__("movl %0, %%cr4" : : "r"(v) : "memory");
+}
+
+/**
+ * Enable SSE/SSE2 instructions if the CPU supports them
+ * @return true if SSE2 code may be executed
+ */
+static inline bool cpu_enable_sse() {
+    if ((cpuid_features_edx() & CPUID_EDX_SSE2) == 0) {
+        return false;
+    }
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    return true;
+}
+
+#endif // CPU_H
@@ -5,13 +5,65 @@
 # ============================================================================
 
 .global _start
+.global idt
+.global boot_magic
+.global boot_info
+.global boot_tsc_entry
+.global boot_tsc_ctors
 .extern kernel_main
 
+# ----------------------------------------------------------------------------
+# Multiboot headers (linker.ld puts .multiboot first in .text). Both are
+# ELF-only: the loader reads the program headers, so no address fields.
+# ----------------------------------------------------------------------------
+.set MB1_MAGIC,    0x1BADB002
+.set MB1_FLAGS,    0x00000003      # page-aligned modules, memory info
+.set MB2_MAGIC,    0xE85250D6
+.set MB2_ARCH_I386, 0
+
+.section .multiboot, "a"
+.align 4
+multiboot1_header:
+    .long MB1_MAGIC
+    .long MB1_FLAGS
+    .long -(MB1_MAGIC + MB1_FLAGS)
+
+.align 8
+multiboot2_header:
+    .long MB2_MAGIC
+    .long MB2_ARCH_I386
+    .long multiboot2_header_end - multiboot2_header
+    .long -(MB2_MAGIC + MB2_ARCH_I386 + (multiboot2_header_end - multiboot2_header))
+    .align 8
+    .word 6, 0                     # module alignment tag: page-align modules
+    .long 8
+    .word 0, 0                     # end tag
+    .long 8
+multiboot2_header_end:
+
 .section .text._start
 .code32
 
 _start:
     cli
+    # A Multiboot loader enters with EAX = magic and EBX = its info block,
+    # flat segments but no GDT or stack we may rely on; boot/loader.asm
+    # passes EAX = 0. bootinfo.cpp reads both later.
+    movl %eax, boot_magic
+    movl %ebx, boot_info
+    lgdt gdt_ptr
+    ljmp $0x08, $1f
+1:  movw $0x10, %ax
+    movw %ax, %ds
+    movw %ax, %es
+    movw %ax, %fs
+    movw %ax, %gs
+    movw %ax, %ss
+    # Stack: conventional memory below 0x90000 (the kernel is at 1 MiB)
+    movl $0x00088000, %esp
+    movl $boot_tsc_entry, %edi
+    call stamp_tsc
+
     # Early serial trace: write "KERNEL PM\n" to COM1 (port 0x3F8)
     leal serial_msg, %esi
     movw $0x3F8, %dx
@@ -28,9 +80,6 @@ _start:
     movl $0x1f4b, %eax   # K in green
     movl %eax, (%edi)
 
-    # GDT already loaded by loader, segment registers already set
-    # Just verify we're in protected mode and continue
-
     # Disable NMI and mask PIC IRQs
     movw $0x70, %dx
     inb (%dx), %al
@@ -46,7 +95,8 @@ _start:
     movl $0x1f4e, %eax   # N in green
     movl %eax, (%edi)
 
-    # Build IDT with halting handler for all vectors
+    # Build IDT with halting handler for all vectors; interrupts_init()
+    # later installs the real exception and IRQ stubs from isr.s
     lea idt, %edi
     xorl %eax, %eax
     movl $256*8/4, %ecx
@@ -79,23 +129,12 @@ _start:
     movl $0x1f49, %eax   # I in green
     movl %eax, (%edi)
 
-    # Stack: use 0x00090000 (kernel at 0x00090000, stack below it)
-    movl $0x00088000, %esp
-    andl $~0xF, %esp          # align to 16 bytes
-
     movl $0xb800A, %edi
     movl $0x1f42, %eax   # B in green
     movl %eax, (%edi)
 
-    # Clear .bss
-    cld
-    movl $__bss_start, %edi
-    movl $__bss_end, %ecx
-    subl %edi, %ecx
-    jbe .after_bss
-    xorl %eax, %eax
-    rep stosb
-.after_bss:
+    # .bss was zeroed by the loader (p_memsz - p_filesz of the data segment;
+    # Multiboot loaders do the same)
 
     movl $0xb8002, %edi
     movl $0x1f4d, %eax   # D in green
@@ -105,12 +144,39 @@ _start:
     movl $0x1f4D, %eax   # M in green
     movl %eax, (%edi)
 
+    movl $boot_tsc_ctors, %edi
+    call stamp_tsc
+
+    # Run global constructors (terminal, filesystem, consoles, ...)
+    movl $__init_array_start, %ebx
+.run_ctors:
+    cmpl $__init_array_end, %ebx
+    jae .ctors_done
+    call *(%ebx)
+    addl $4, %ebx
+    jmp .run_ctors
+.ctors_done:
+
     call kernel_main
 
 .hang:
     hlt
     jmp .hang
 
+# ----------------------------------------------------------------------------
+# stamp_tsc: store the TSC at (%edi) for bootstat.cpp, if the CPU has one
+# Clobbers: eax, ebx, ecx, edx
+# ----------------------------------------------------------------------------
+stamp_tsc:
+    movl $1, %eax
+    cpuid
+    testl $0x10, %edx              # CPUID.1:EDX.TSC
+    jz 1f
+    rdtsc
+    movl %eax, 0(%edi)
+    movl %edx, 4(%edi)
+1:  ret
+
 # IDT
 .section .data
 .align 8
@@ -120,6 +186,18 @@ idt_ptr:
     .word (256*8 - 1)
     .long idt
 
+.align 4
+boot_magic:
+    .long 0
+boot_info:
+    .long 0
+
+.align 8
+boot_tsc_entry:
+    .quad 0
+boot_tsc_ctors:
+    .quad 0
+
 # Serial message used by early kernel trace
 .align 1
 serial_msg:
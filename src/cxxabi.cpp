@@ -1,6 +1,8 @@
 // Minimal C++ runtime and C library stubs for freestanding -m32 build
 
 #include "types.h"
+#include "heap.h"
+#include "kstats.h"
 #include <cstring>
 #include <cstddef>
 
@@ -37,13 +39,68 @@ extern "C" {
         return n;
     }
 
+    // 64-bit division helpers normally provided by libgcc. The common case
+    // (divisor fits in 32 bits) is two hardware divides; anything else falls
+    // back to shift-and-subtract. Written without '/' on 64-bit operands so
+    // the compiler cannot turn them back into calls to themselves.
+    static uint64_t udivmod64(uint64_t n, uint64_t d, uint64_t* rem) {
+        uint64_t q = 0;
+        if ((d >> 32) == 0) {
+            uint32_t d32 = (uint32_t)d;
+            uint32_t hi = (uint32_t)(n >> 32);
+            uint32_t lo = (uint32_t)n;
+            uint32_t q_hi = hi / d32;
+            uint32_t r = hi % d32;
+            uint32_t q_lo;
+            asm("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(r), "rm"(d32));
+            q = ((uint64_t)q_hi << 32) | q_lo;
+            if (rem) *rem = r;
+            return q;
+        }
+        uint64_t r = 0;
+        for (int i = 63; i >= 0; --i) {
+            r = (r << 1) | ((n >> i) & 1);
+            if (r >= d) {
+                r -= d;
+                q |= (uint64_t)1 << i;
+            }
+        }
+        if (rem) *rem = r;
+        return q;
+    }
+
+    uint64_t __udivdi3(uint64_t n, uint64_t d) { return udivmod64(n, d, nullptr); }
+
+    uint64_t __umoddi3(uint64_t n, uint64_t d) {
+        uint64_t r;
+        udivmod64(n, d, &r);
+        return r;
+    }
+
+    int64_t __divdi3(int64_t n, int64_t d) {
+        bool neg = (n < 0) != (d < 0);
+        uint64_t q = udivmod64(n < 0 ? -(uint64_t)n : n, d < 0 ? -(uint64_t)d : d, nullptr);
+        return neg ? -(int64_t)q : (int64_t)q;
+    }
+
+    int64_t __moddi3(int64_t n, int64_t d) {
+        uint64_t r;
+        udivmod64(n < 0 ? -(uint64_t)n : n, d < 0 ? -(uint64_t)d : d, &r);
+        return n < 0 ? -(int64_t)r : (int64_t)r;
+    }
+
     // Minimal new/delete (simple bump allocator)
     static uint8_t heap_pool[65536];
     static uint32_t heap_pos = 0;
+    KSTAT_GAUGE(stat_heap_bytes, "heap.bytes_live");
+    KSTAT_COUNTER(stat_heap_allocs, "heap.allocations");
+
     void* operator new(size_t size) throw() {
         if (heap_pos + size > sizeof(heap_pool)) return nullptr;
         void* ptr = &heap_pool[heap_pos];
         heap_pos += ((size + 7) & ~7); // align
+        kstat_inc(stat_heap_allocs);
+        kstat_set(stat_heap_bytes, heap_pos);
         return ptr;
     }
 
@@ -51,9 +108,19 @@ extern "C" {
         if (heap_pos + size > sizeof(heap_pool)) return nullptr;
         void* ptr = &heap_pool[heap_pos];
         heap_pos += ((size + 7) & ~7);
+        kstat_inc(stat_heap_allocs);
+        kstat_set(stat_heap_bytes, heap_pos);
         return ptr;
     }
 
+    // Roll the bump pointer back (see heap.h)
+    uint32_t heap_mark() { return heap_pos; }
+    void heap_release(uint32_t mark) {
+        if (mark <= heap_pos) heap_pos = mark;
+        kstat_set(stat_heap_bytes, heap_pos);
+    }
+    uint32_t heap_used() { return heap_pos; }
+
     void operator delete(void* ptr, uint32_t) throw() { (void)ptr; }
     void operator delete[](void* ptr) throw() { (void)ptr; }
 
@@ -0,0 +1,342 @@
+/*
+ * RusticOS framebuffer console
+ * ----------------------------
+ * Rendering happens in a 32bpp shadow buffer in RAM; flush() copies the
+ * dirty rectangle to the linear framebuffer. The hot loops have an SSE2
+ * version built with the target attribute (the rest of the kernel is
+ * compiled without SSE) and a scalar fallback for CPUs without it.
+ *
+ * Glyph expansion uses a 16-entry table of 4-pixel masks: each font row
+ * byte selects two masks and every pixel becomes (fg & m) | (bg & ~m), so
+ * an 8-pixel row is two 16-byte stores with no per-pixel branches.
+ */
+
+#include "fbconsole.h"
+#include "cpu.h"
+#include "kstats.h"
+#include "trace.h"
+
+FramebufferConsole fbcon;
+
+typedef uint32_t v4u __attribute__((vector_size(16), aligned(4)));
+
+// VGA text attribute colors as 0x00RRGGBB
+static const uint32_t VGA_PALETTE[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+// NIBBLE_MASKS[n][i] is all ones when bit (3 - i) of n is set (MSB = left)
+static uint32_t NIBBLE_MASKS[16][4] __attribute__((aligned(16)));
+
+// ----------------------------------------------------------------------------
+// Pixel kernels
+// ----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static void glyph_sse2(uint32_t* dst, uint32_t pitch, const uint8_t* glyph,
+                       uint32_t fg, uint32_t bg) {
+    const v4u vfg = { fg, fg, fg, fg };
+    const v4u vbg = { bg, bg, bg, bg };
+    for (uint32_t y = 0; y < FB_FONT_HEIGHT; ++y, dst += pitch) {
+        const uint8_t bits = glyph[y];
+        const v4u m0 = *(const v4u*)NIBBLE_MASKS[bits >> 4];
+        const v4u m1 = *(const v4u*)NIBBLE_MASKS[bits & 0xF];
+        ((v4u*)dst)[0] = (vfg & m0) | (vbg & ~m0);
+        ((v4u*)dst)[1] = (vfg & m1) | (vbg & ~m1);
+    }
+}
+
+static void glyph_scalar(uint32_t* dst, uint32_t pitch, const uint8_t* glyph,
+                         uint32_t fg, uint32_t bg) {
+    for (uint32_t y = 0; y < FB_FONT_HEIGHT; ++y, dst += pitch) {
+        const uint8_t bits = glyph[y];
+        for (uint32_t x = 0; x < FB_FONT_WIDTH; ++x) {
+            dst[x] = (bits & (0x80 >> x)) ? fg : bg;
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void fill_sse2(uint32_t* dst, uint32_t pitch, uint32_t w, uint32_t h, uint32_t color) {
+    const v4u v = { color, color, color, color };
+    for (uint32_t y = 0; y < h; ++y, dst += pitch) {
+        uint32_t x = 0;
+        for (; x + 4 <= w; x += 4) *(v4u*)(dst + x) = v;
+        for (; x < w; ++x) dst[x] = color;
+    }
+}
+
+static void fill_scalar(uint32_t* dst, uint32_t pitch, uint32_t w, uint32_t h, uint32_t color) {
+    for (uint32_t y = 0; y < h; ++y, dst += pitch) {
+        for (uint32_t x = 0; x < w; ++x) dst[x] = color;
+    }
+}
+
+// Row-wise copy; safe for overlapping moves towards lower addresses
+__attribute__((target("sse2")))
+static void copy_sse2(volatile uint32_t* dst, uint32_t dst_pitch, const uint32_t* src,
+                      uint32_t src_pitch, uint32_t w, uint32_t h) {
+    for (uint32_t y = 0; y < h; ++y, dst += dst_pitch, src += src_pitch) {
+        uint32_t x = 0;
+        for (; x + 8 <= w; x += 8) {
+            v4u a = *(const v4u*)(src + x);
+            v4u b = *(const v4u*)(src + x + 4);
+            *(v4u*)(dst + x) = a;
+            *(v4u*)(dst + x + 4) = b;
+        }
+        for (; x < w; ++x) dst[x] = src[x];
+    }
+}
+
+static void copy_scalar(volatile uint32_t* dst, uint32_t dst_pitch, const uint32_t* src,
+                        uint32_t src_pitch, uint32_t w, uint32_t h) {
+    for (uint32_t y = 0; y < h; ++y, dst += dst_pitch, src += src_pitch) {
+        for (uint32_t x = 0; x < w; ++x) dst[x] = src[x];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Console
+// ----------------------------------------------------------------------------
+bool FramebufferConsole::init(const VbeHandoff* info) {
+    active = false;
+    if (!info || info->magic != VBE_HANDOFF_MAGIC || info->bpp != 32) {
+        return false;
+    }
+
+    framebuffer = (volatile uint32_t*)info->framebuffer;
+    shadow = (uint32_t*)FB_SHADOW_BASE;
+    fb_pitch = info->pitch / 4;
+    width = info->width;
+    height = info->height;
+    screen_columns = columns = width / FB_FONT_WIDTH;
+    screen_rows = rows = height / FB_FONT_HEIGHT;
+    use_sse = cpu_enable_sse();
+
+    // The loader's copy lives in low memory that the kernel may reuse
+    const uint8_t* rom_font = (const uint8_t*)info->font;
+    for (uint32_t i = 0; i < sizeof(font); ++i) {
+        font[i] = rom_font[i];
+    }
+
+    for (uint32_t n = 0; n < 16; ++n) {
+        for (uint32_t i = 0; i < 4; ++i) {
+            NIBBLE_MASKS[n][i] = (n & (8 >> i)) ? 0xFFFFFFFF : 0;
+        }
+    }
+
+    active = true;
+    setColor(7, 0);
+    clear();
+    return true;
+}
+
+void FramebufferConsole::setTextArea(uint16_t text_columns, uint16_t text_rows) {
+    columns = (text_columns < screen_columns) ? text_columns : screen_columns;
+    rows = (text_rows < screen_rows) ? text_rows : screen_rows;
+    if (cursor_x > columns) cursor_x = columns;
+    if (cursor_y >= rows) cursor_y = rows - 1;
+}
+
+void FramebufferConsole::setCursor(uint16_t col, uint16_t row) {
+    if (!active) return;
+    cursor_x = (col < columns) ? col : columns - 1;
+    cursor_y = (row < rows) ? row : rows - 1;
+    flush();    // moves the drawn cursor
+}
+
+void FramebufferConsole::setColor(uint8_t fg, uint8_t bg) {
+    foreground = VGA_PALETTE[fg & 0xF];
+    background = VGA_PALETTE[bg & 0xF];
+}
+
+void FramebufferConsole::mark_dirty(uint16_t col, uint16_t row, uint16_t w, uint16_t h) {
+    if (dirty_x1 == 0) {
+        dirty_x0 = col; dirty_y0 = row;
+        dirty_x1 = col + w; dirty_y1 = row + h;
+        return;
+    }
+    if (col < dirty_x0) dirty_x0 = col;
+    if (row < dirty_y0) dirty_y0 = row;
+    if (col + w > dirty_x1) dirty_x1 = col + w;
+    if (row + h > dirty_y1) dirty_y1 = row + h;
+}
+
+void FramebufferConsole::draw_glyph(uint16_t col, uint16_t row, uint8_t c) {
+    uint32_t* dst = shadow + (uint32_t)row * FB_FONT_HEIGHT * width + col * FB_FONT_WIDTH;
+    const uint8_t* glyph = &font[c * FB_FONT_HEIGHT];
+    if (use_sse) {
+        glyph_sse2(dst, width, glyph, foreground, background);
+    } else {
+        glyph_scalar(dst, width, glyph, foreground, background);
+    }
+}
+
+void FramebufferConsole::fill_cells(uint16_t col, uint16_t row, uint16_t w, uint16_t h, uint32_t color) {
+    uint32_t* dst = shadow + (uint32_t)row * FB_FONT_HEIGHT * width + col * FB_FONT_WIDTH;
+    if (use_sse) {
+        fill_sse2(dst, width, w * FB_FONT_WIDTH, h * FB_FONT_HEIGHT, color);
+    } else {
+        fill_scalar(dst, width, w * FB_FONT_WIDTH, h * FB_FONT_HEIGHT, color);
+    }
+    mark_dirty(col, row, w, h);
+}
+
+void FramebufferConsole::clear() {
+    if (!active) return;
+    fill_cells(0, 0, columns, rows, background);
+    cursor_x = cursor_y = 0;
+    flush();
+}
+
+void FramebufferConsole::scroll_up(uint16_t lines) {
+    if (lines > rows) lines = rows;
+    const uint32_t line_pixels = (uint32_t)lines * FB_FONT_HEIGHT * width;
+    const uint32_t keep_rows = (uint32_t)(rows - lines) * FB_FONT_HEIGHT;
+
+    // memmove of the shadow buffer; the destination is below the source
+    if (use_sse) {
+        copy_sse2(shadow, width, shadow + line_pixels, width, width, keep_rows);
+    } else {
+        copy_scalar(shadow, width, shadow + line_pixels, width, width, keep_rows);
+    }
+    fill_cells(0, rows - lines, columns, lines, background);
+    mark_dirty(0, 0, columns, rows);
+}
+
+void FramebufferConsole::new_line() {
+    cursor_x = 0;
+    if (++cursor_y >= rows) {
+        scroll_up(1);
+        cursor_y = rows - 1;
+    }
+}
+
+void FramebufferConsole::put_control(char c) {
+    switch (c) {
+    case '\n': new_line(); break;
+    case '\r': cursor_x = 0; break;
+    case '\t':
+        cursor_x = (cursor_x + 8) & ~7;
+        if (cursor_x >= columns) new_line();
+        break;
+    case '\b':
+        if (cursor_x > 0) cursor_x--;
+        break;
+    default:
+        break;
+    }
+}
+
+void FramebufferConsole::write(const char* data, uint32_t length) {
+    if (!active) return;
+
+    uint32_t i = 0;
+    while (i < length) {
+        char c = data[i];
+        if (c == '\n' || c == '\r' || c == '\t' || c == '\b') {
+            put_control(c);
+            i++;
+            continue;
+        }
+
+        if (cursor_x >= columns) {
+            new_line();
+        }
+
+        // Render a run of printable characters on the current row
+        uint16_t start = cursor_x;
+        while (i < length && cursor_x < columns) {
+            c = data[i];
+            if (c == '\n' || c == '\r' || c == '\t' || c == '\b') break;
+            draw_glyph(cursor_x++, cursor_y, (uint8_t)c);
+            i++;
+        }
+        mark_dirty(start, cursor_y, cursor_x - start, 1);
+    }
+
+    flush();
+}
+
+void FramebufferConsole::write(const char* str) {
+    uint32_t length = 0;
+    while (str[length]) length++;
+    write(str, length);
+}
+
+void FramebufferConsole::renderText(const uint16_t* cells, uint16_t text_columns, uint16_t text_rows,
+                                    uint16_t cursor_col, uint16_t cursor_row) {
+    if (!active) return;
+
+    fill_cells(0, 0, screen_columns, screen_rows, background);
+
+    uint16_t h = (text_rows < rows) ? text_rows : rows;
+    for (uint16_t y = 0; y < h; ++y) {
+        draw_cells(y, &cells[y * text_columns], text_columns);
+    }
+
+    cursor_x = cursor_col;
+    cursor_y = cursor_row;
+    flush();
+}
+
+void FramebufferConsole::renderRow(uint16_t row, const uint16_t* cells, uint16_t count) {
+    if (!active || row >= rows) return;
+    draw_cells(row, cells, count);
+}
+
+void FramebufferConsole::draw_cells(uint16_t row, const uint16_t* cells, uint16_t count) {
+    const uint32_t saved_fg = foreground, saved_bg = background;
+    uint16_t w = (count < columns) ? count : columns;
+    for (uint16_t x = 0; x < w; ++x) {
+        uint16_t cell = cells[x];
+        foreground = VGA_PALETTE[(cell >> 8) & 0xF];
+        background = VGA_PALETTE[(cell >> 12) & 0xF];
+        draw_glyph(x, row, (uint8_t)cell);
+    }
+    foreground = saved_fg;
+    background = saved_bg;
+    mark_dirty(0, row, w, 1);
+}
+
+void FramebufferConsole::draw_cursor() {
+    // Painted straight into video memory; the shadow copy stays clean so the
+    // next flush of this cell erases it
+    if (cursor_x >= columns || cursor_y >= rows) return;
+    volatile uint32_t* dst = framebuffer
+        + ((uint32_t)cursor_y * FB_FONT_HEIGHT + FB_FONT_HEIGHT - 2) * fb_pitch
+        + cursor_x * FB_FONT_WIDTH;
+    for (uint32_t y = 0; y < 2; ++y, dst += fb_pitch) {
+        for (uint32_t x = 0; x < FB_FONT_WIDTH; ++x) dst[x] = foreground;
+    }
+    drawn_cursor_x = cursor_x;
+    drawn_cursor_y = cursor_y;
+}
+
+KSTAT_COUNTER(stat_fb_cells_flushed, "fb.cells_flushed");
+
+void FramebufferConsole::flush() {
+    if (!active) return;
+    TRACE_SCOPE("fb.flush", 0);
+
+    // Erase the previously painted cursor by repainting its cell
+    if (drawn_cursor_x < columns && drawn_cursor_y < rows) {
+        mark_dirty(drawn_cursor_x, drawn_cursor_y, 1, 1);
+    }
+
+    if (dirty_x1 > dirty_x0 && dirty_y1 > dirty_y0) {
+        const uint32_t x = dirty_x0 * FB_FONT_WIDTH;
+        const uint32_t y = dirty_y0 * FB_FONT_HEIGHT;
+        const uint32_t w = (dirty_x1 - dirty_x0) * FB_FONT_WIDTH;
+        const uint32_t h = (dirty_y1 - dirty_y0) * FB_FONT_HEIGHT;
+        kstat_add(stat_fb_cells_flushed, (uint32_t)(dirty_x1 - dirty_x0) * (dirty_y1 - dirty_y0));
+        if (use_sse) {
+            copy_sse2(framebuffer + y * fb_pitch + x, fb_pitch, shadow + y * width + x, width, w, h);
+        } else {
+            copy_scalar(framebuffer + y * fb_pitch + x, fb_pitch, shadow + y * width + x, width, w, h);
+        }
+    }
+    dirty_x0 = dirty_y0 = dirty_x1 = dirty_y1 = 0;
+
+    draw_cursor();
+}
@@ -0,0 +1,101 @@
+#ifndef FBCONSOLE_H
+#define FBCONSOLE_H
+
+#include "types.h"
+
+/*
+ * Framebuffer console for RusticOS
+ * --------------------------------
+ * - Pixel console on a VBE linear framebuffer set up by the loader
+ *   (build with `make VESA=1`); with 1280x800 and the 8x16 BIOS font it
+ *   provides 160x50 cells
+ * - Glyphs and rectangles are rendered into a RAM shadow buffer with SSE2
+ *   when available; scrolling is a memmove of the shadow buffer
+ * - Only the dirty rectangle is copied to video memory, once per write()
+ * - While it mirrors a Terminal, setTextArea() limits output to that
+ *   terminal's size (80x25 in the top-left corner) so both wrap and scroll
+ *   at the same place; the rest of the screen stays blank
+ */
+
+// Handoff block written by boot/loader.asm (setup_vesa)
+#define VBE_HANDOFF_ADDR  0x0600
+#define VBE_HANDOFF_MAGIC 0x31454256    // 'VBE1'
+
+struct VbeHandoff {
+    uint32_t magic;
+    uint32_t framebuffer;   // physical address of the linear framebuffer
+    uint16_t width;         // pixels
+    uint16_t height;        // pixels
+    uint16_t pitch;         // bytes per scanline
+    uint8_t bpp;            // always 32 when magic is valid
+    uint8_t reserved;
+    uint32_t font;          // physical address of the 8x16 font (256 glyphs)
+} __attribute__((packed));
+
+// RAM back buffer for the framebuffer (paging is off, so this is physical)
+#define FB_SHADOW_BASE   0x01000000
+#define FB_FONT_WIDTH    8
+#define FB_FONT_HEIGHT   16
+
+class FramebufferConsole {
+private:
+    volatile uint32_t* framebuffer;
+    uint32_t* shadow;
+    uint32_t fb_pitch;              // framebuffer pitch in pixels
+    uint16_t width;                 // pixels
+    uint16_t height;                // pixels
+    uint16_t screen_columns;        // cells that fit on the screen
+    uint16_t screen_rows;
+    uint16_t columns;               // text area in use (see setTextArea)
+    uint16_t rows;
+    uint16_t cursor_x;
+    uint16_t cursor_y;
+    uint16_t drawn_cursor_x;        // where the cursor was last painted
+    uint16_t drawn_cursor_y;
+    uint32_t foreground;            // 0x00RRGGBB
+    uint32_t background;
+    bool active;
+    bool use_sse;
+
+    // Dirty rectangle in cells, [x0, x1) x [y0, y1)
+    uint16_t dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+
+    uint8_t font[256 * FB_FONT_HEIGHT];
+
+    void draw_glyph(uint16_t col, uint16_t row, uint8_t c);
+    void fill_cells(uint16_t col, uint16_t row, uint16_t w, uint16_t h, uint32_t color);
+    void scroll_up(uint16_t lines);
+    void new_line();
+    void put_control(char c);
+    void mark_dirty(uint16_t col, uint16_t row, uint16_t w, uint16_t h);
+    void draw_cursor();
+    void draw_cells(uint16_t row, const uint16_t* cells, uint16_t count);
+
+public:
+    bool init(const VbeHandoff* info);
+    bool is_active() const { return active; }
+
+    void clear();
+    void setColor(uint8_t fg, uint8_t bg);
+    void setCursor(uint16_t col, uint16_t row);     // clamped to the text area
+    void write(const char* data, uint32_t length);
+    void write(const char* str);
+    void flush();
+
+    // Wrap and scroll within the top-left text_columns x text_rows cells
+    // (clamped to the screen)
+    void setTextArea(uint16_t text_columns, uint16_t text_rows);
+
+    // Redraw from a VGA-format (char | attr << 8) text screen
+    void renderText(const uint16_t* cells, uint16_t text_columns, uint16_t text_rows,
+                    uint16_t cursor_col, uint16_t cursor_row);
+    // Redraw one row from VGA-format cells; shown by the next flush()
+    void renderRow(uint16_t row, const uint16_t* cells, uint16_t count);
+
+    uint16_t getColumns() const { return columns; }
+    uint16_t getRows() const { return rows; }
+};
+
+extern FramebufferConsole fbcon;
+
+#endif // FBCONSOLE_H
@@ -1,9 +1,15 @@
 #include "filesystem.h"
 #include "terminal.h"
+#include "stream.h"
+#include "kstats.h"
+#include "trace.h"
 #include <cstring>
 
 extern Terminal terminal;
 
+KSTAT_COUNTER(stat_fs_lookups, "fs.lookups");
+KSTAT_COUNTER(stat_fs_probes, "fs.probes");
+
 FileSystem::FileSystem() : root(nullptr), current_dir(nullptr) {
     root = new FileNode();
     root->name[0] = '\0';
@@ -34,16 +40,21 @@ void FileSystem::free_node(FileNode* node) {
 }
 
 FileNode* FileSystem::find_child(FileNode* parent, const char* name) {
+    TRACE_SCOPE("fs.lookup", 0);
     if (!parent || !name) return nullptr;
+    kstat_inc(stat_fs_lookups);
     for (uint32_t i = 0; i < parent->child_count; ++i) {
         if (strcmp(parent->children[i]->name, name) == 0) {
+            kstat_add(stat_fs_probes, i + 1);
             return parent->children[i];
         }
     }
+    kstat_add(stat_fs_probes, parent->child_count);
     return nullptr;
 }
 
 bool FileSystem::mkdir(const char* name) {
+    TRACE_SCOPE("fs.mkdir", 0);
     if (!name || !current_dir || current_dir->child_count >= MAX_DIRECTORY_ENTRIES) {
         return false;
     }
@@ -67,6 +78,7 @@ bool FileSystem::mkdir(const char* name) {
 }
 
 bool FileSystem::rmdir(const char* name) {
+    TRACE_SCOPE("fs.rmdir", 0);
     if (!name || !current_dir) return false;
     
     FileNode* dir = find_child(current_dir, name);
@@ -90,6 +102,7 @@ bool FileSystem::rmdir(const char* name) {
 }
 
 bool FileSystem::cd(const char* path) {
+    TRACE_SCOPE("fs.cd", 0);
     if (!path || !current_dir) return false;
     
     if (strcmp(path, "/") == 0) {
@@ -110,7 +123,8 @@ bool FileSystem::cd(const char* path) {
     return false;
 }
 
-void FileSystem::ls() {
+void FileSystem::ls(OutputStream& out) {
+    TRACE_SCOPE("fs.ls", 0);
     if (!current_dir) {
         terminal.write("Error: no current directory\n");
         return;
@@ -118,21 +132,22 @@ void FileSystem::ls() {
     
     for (uint32_t i = 0; i < current_dir->child_count; i++) {
         FileNode* child = current_dir->children[i];
-        terminal.write(child->name);
+        out.write(child->name);
         if (child->type == FILE_TYPE_DIRECTORY) {
-            terminal.write("/");
+            out.write("/");
         }
-        terminal.write("\n");
+        out.write("\n");
     }
 }
 
-bool FileSystem::pwd() {
+bool FileSystem::pwd(OutputStream& out) {
     if (!current_dir) return false;
-    terminal.write("/\n");
+    out.write("/\n");
     return true;
 }
 
 bool FileSystem::create_file(const char* name, const char* content) {
+    TRACE_SCOPE("fs.create", 0);
     if (!name || !current_dir || current_dir->child_count >= MAX_DIRECTORY_ENTRIES) {
         return false;
     }
@@ -166,6 +181,7 @@ bool FileSystem::create_file(const char* name, const char* content) {
 }
 
 bool FileSystem::delete_file(const char* name) {
+    TRACE_SCOPE("fs.delete", 0);
     if (!name || !current_dir) return false;
     
     FileNode* file = find_child(current_dir, name);
@@ -187,7 +203,13 @@ bool FileSystem::delete_file(const char* name) {
     return true;
 }
 
+const FileNode* FileSystem::find_file(const char* name) {
+    FileNode* node = find_child(current_dir, name);
+    return (node && node->type == FILE_TYPE_FILE) ? node : nullptr;
+}
+
 bool FileSystem::read_file(const char* name, char* buffer, uint32_t max_size) {
+    TRACE_SCOPE("fs.read", max_size);
     if (!name || !buffer || !current_dir) return false;
     
     FileNode* file = find_child(current_dir, name);
@@ -201,24 +223,66 @@ bool FileSystem::read_file(const char* name, char* buffer, uint32_t max_size) {
     return true;
 }
 
+/**
+ * Make room for `capacity` bytes of content plus the NUL terminator,
+ * growing geometrically so repeated appends stay amortized O(1)
+ */
+bool FileSystem::reserve(FileNode* file, uint32_t capacity) {
+    if (capacity < file->data_capacity) {
+        return true;
+    }
+
+    uint32_t new_capacity = file->data_capacity ? file->data_capacity : 64;
+    while (new_capacity <= capacity) {
+        new_capacity *= 2;
+    }
+
+    char* data = new char[new_capacity];
+    if (!data) {
+        return false;
+    }
+    if (file->data) {
+        memcpy(data, file->data, file->size);
+        delete[] file->data;
+    }
+    file->data = data;
+    file->data_capacity = new_capacity;
+    return true;
+}
+
 bool FileSystem::write_file(const char* name, const char* content) {
-    if (!name || !content || !current_dir) return false;
+    if (!content) return false;
+    return write_file(name, content, strlen(content));
+}
+
+bool FileSystem::write_file(const char* name, const char* data, uint32_t length) {
+    TRACE_SCOPE("fs.write", length);
+    if (!name || !current_dir) return false;
     
     FileNode* file = find_child(current_dir, name);
     if (!file || file->type != FILE_TYPE_FILE) {
         return false;
     }
-    
-    uint32_t content_len = strlen(content);
-    if (content_len > file->data_capacity) {
-        delete[] file->data;
-        file->data_capacity = content_len + 1;
-        file->data = new char[file->data_capacity];
+
+    file->size = 0;
+    return append_file(name, data, length);
+}
+
+bool FileSystem::append_file(const char* name, const char* data, uint32_t length) {
+    TRACE_SCOPE("fs.append", length);
+    if (!name || (!data && length > 0) || !current_dir) return false;
+
+    FileNode* file = find_child(current_dir, name);
+    if (!file || file->type != FILE_TYPE_FILE) {
+        return false;
     }
-    
-    strncpy(file->data, content, file->data_capacity - 1);
-    file->data[file->data_capacity - 1] = '\0';
-    file->size = content_len;
+
+    if (!reserve(file, file->size + length)) {
+        return false;
+    }
+    memcpy(file->data + file->size, data, length);
+    file->size += length;
+    file->data[file->size] = '\0';
     return true;
 }
 
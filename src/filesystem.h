@@ -3,6 +3,8 @@
 
 #include "types.h"
 
+class OutputStream;
+
 #define MAX_NAME_LENGTH 32
 #define MAX_PATH_LENGTH 256
 #define MAX_DIRECTORY_ENTRIES 64
@@ -38,6 +40,7 @@ private:
     FileNode* find_child(FileNode* parent, const char* name);
     void free_node(FileNode* node);
     void print_tree(FileNode* node, int depth);
+    bool reserve(FileNode* file, uint32_t capacity);
     
 public:
     FileSystem();
@@ -46,13 +49,16 @@ public:
     bool mkdir(const char* path);
     bool rmdir(const char* path);
     bool cd(const char* path);
-    void ls();
-    bool pwd();
+    void ls(OutputStream& out);
+    bool pwd(OutputStream& out);
     
     bool create_file(const char* name, const char* content);
     bool delete_file(const char* name);
+    const FileNode* find_file(const char* name);
     bool read_file(const char* name, char* buffer, uint32_t max_size);
     bool write_file(const char* name, const char* content);
+    bool write_file(const char* name, const char* data, uint32_t length);
+    bool append_file(const char* name, const char* data, uint32_t length);
     
     void save_to_disk();
     bool load_from_disk();
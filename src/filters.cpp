@@ -0,0 +1,103 @@
+/*
+ * RusticOS pipeline filters (grep, head, wc)
+ */
+
+#include "filters.h"
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// LineFilter
+// ---------------------------------------------------------------------------
+
+void LineFilter::put(const char* data, uint32_t data_length) {
+    for (uint32_t i = 0; i < data_length; ++i) {
+        line[length++] = data[i];
+        if (data[i] == '\n' || length == FILTER_LINE_MAX) {
+            on_line(line, length);
+            length = 0;
+        }
+    }
+}
+
+void LineFilter::close() {
+    if (length > 0) {
+        on_line(line, length);
+        length = 0;
+    }
+    out->close();
+}
+
+// ---------------------------------------------------------------------------
+// GrepFilter
+// ---------------------------------------------------------------------------
+
+void GrepFilter::start(OutputStream* next, const char* needle) {
+    LineFilter::start(next);
+    pattern = needle;
+    pattern_length = strlen(needle);
+}
+
+void GrepFilter::on_line(const char* text, uint32_t text_length) {
+    if (pattern_length > text_length) {
+        return;
+    }
+    for (uint32_t i = 0; i + pattern_length <= text_length; ++i) {
+        uint32_t j = 0;
+        while (j < pattern_length && text[i + j] == pattern[j]) j++;
+        if (j == pattern_length) {
+            out->write(text, text_length);
+            return;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// HeadFilter
+// ---------------------------------------------------------------------------
+
+void HeadFilter::start(OutputStream* next, uint32_t lines) {
+    LineFilter::start(next);
+    remaining = lines;
+}
+
+void HeadFilter::on_line(const char* text, uint32_t text_length) {
+    if (remaining == 0) {
+        return;
+    }
+    out->write(text, text_length);
+    if (text[text_length - 1] == '\n') {
+        remaining--;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// WcFilter
+// ---------------------------------------------------------------------------
+
+void WcFilter::start(OutputStream* next) {
+    out = next;
+    lines = 0;
+    words = 0;
+    bytes = 0;
+    in_word = false;
+}
+
+void WcFilter::put(const char* data, uint32_t length) {
+    bytes += length;
+    for (uint32_t i = 0; i < length; ++i) {
+        char c = data[i];
+        bool blank = (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        if (c == '\n') {
+            lines++;
+        }
+        if (!blank && !in_word) {
+            words++;
+        }
+        in_word = !blank;
+    }
+}
+
+void WcFilter::close() {
+    kfprintf(*out, "%u %u %u\n", lines, words, bytes);
+    out->close();
+}
@@ -0,0 +1,94 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include "types.h"
+#include "stream.h"
+
+/*
+ * Pipeline filters
+ * ----------------
+ * - Each filter is an OutputStream: the upstream command writes into it and
+ *   it writes its result to the next stream in the chain
+ * - Line-oriented filters keep at most one line (FILTER_LINE_MAX bytes);
+ *   longer lines are processed in FILTER_LINE_MAX-sized pieces
+ * - close() emits anything still pending (e.g. wc totals) and then closes
+ *   the downstream stream
+ */
+
+#define FILTER_LINE_MAX 256
+
+class LineFilter : public OutputStream {
+private:
+    char line[FILTER_LINE_MAX];
+    uint32_t length;
+
+protected:
+    OutputStream* out;
+
+    void start(OutputStream* next) { out = next; length = 0; }
+
+    // Called per complete line (newline included) or trailing fragment
+    virtual void on_line(const char* text, uint32_t text_length) = 0;
+
+    void put(const char* data, uint32_t data_length) override;
+
+public:
+    LineFilter() : length(0), out(nullptr) {}
+    void close() override;
+};
+
+// Lines containing a fixed substring
+class GrepFilter : public LineFilter {
+private:
+    const char* pattern;
+    uint32_t pattern_length;
+
+protected:
+    void on_line(const char* text, uint32_t text_length) override;
+
+public:
+    void start(OutputStream* next, const char* needle);
+};
+
+// The first N lines
+class HeadFilter : public LineFilter {
+private:
+    uint32_t remaining;
+
+protected:
+    void on_line(const char* text, uint32_t text_length) override;
+
+public:
+    void start(OutputStream* next, uint32_t lines);
+};
+
+// Line, word and byte counts, printed when the stream closes
+class WcFilter : public OutputStream {
+private:
+    OutputStream* out;
+    uint32_t lines;
+    uint32_t words;
+    uint32_t bytes;
+    bool in_word;
+
+protected:
+    void put(const char* data, uint32_t length) override;
+
+public:
+    WcFilter() : out(nullptr), lines(0), words(0), bytes(0), in_word(false) {}
+    void start(OutputStream* next);
+    void close() override;
+};
+
+/*
+ * Storage for one pipeline stage, kept in a stack-local array by the shell.
+ * Only the filter that the stage's command selects is used.
+ */
+struct PipelineStage {
+    PipeStream pipe;
+    GrepFilter grep;
+    HeadFilter head;
+    WcFilter wc;
+};
+
+#endif // FILTERS_H
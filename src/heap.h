@@ -0,0 +1,20 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "types.h"
+
+/*
+ * Kernel heap (cxxabi.cpp)
+ * ------------------------
+ * operator new is a 64 KiB bump allocator and delete is a no-op. A caller
+ * that knows nothing else allocates meanwhile (benchmarks, scratch work)
+ * can take a mark and release everything allocated after it in one step.
+ */
+
+extern "C" {
+    uint32_t heap_mark();
+    void heap_release(uint32_t mark);
+    uint32_t heap_used();
+}
+
+#endif // HEAP_H
@@ -0,0 +1,237 @@
+/*
+ * RusticOS interrupt handling
+ * ---------------------------
+ * Installs the isr.s entry stubs into the IDT built by crt0, remaps the
+ * 8259 pair and dispatches IRQs to registered driver handlers. CPU
+ * exceptions are fatal: they are logged (and flushed to COM1) before the
+ * CPU halts.
+ */
+
+#include "interrupts.h"
+#include "io.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "kstats.h"
+#include "thread.h"
+#include "lapic.h"
+#include "profile.h"
+#include "trace.h"
+
+// 8259 PIC ports and commands
+#define PIC1_COMMAND    0x20
+#define PIC1_DATA       0x21
+#define PIC2_COMMAND    0xA0
+#define PIC2_DATA       0xA1
+
+#define PIC_ICW1_INIT   0x11    // Edge triggered, cascade, ICW4 follows
+#define PIC_ICW4_8086   0x01
+#define PIC_EOI         0x20
+#define PIC_READ_ISR    0x0B    // OCW3: next read returns the in-service reg
+
+#define IDT_VECTORS     (LOCAL_VECTOR_BASE + LOCAL_VECTOR_COUNT)
+#define IDT_INTERRUPT_GATE 0x8E // Present, ring 0, 32-bit interrupt gate
+#define KERNEL_CODE_SELECTOR 0x08
+
+struct IdtEntry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr;
+    uint16_t offset_high;
+} __attribute__((packed));
+
+// Defined in crt0.s / isr.s
+extern "C" IdtEntry idt[256];
+extern "C" const uint32_t isr_table[IDT_VECTORS];
+extern "C" void isr_spurious();
+
+struct IdtPointer {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+static IrqHandler irq_handlers[IRQ_COUNT];
+static IrqHandler local_handlers[LOCAL_VECTOR_COUNT];
+
+static const char* const exception_names[32] = {
+    "Divide error", "Debug", "NMI", "Breakpoint", "Overflow",
+    "BOUND range exceeded", "Invalid opcode", "Device not available",
+    "Double fault", "Coprocessor segment overrun", "Invalid TSS",
+    "Segment not present", "Stack-segment fault", "General protection",
+    "Page fault", "Reserved", "x87 floating-point", "Alignment check",
+    "Machine check", "SIMD floating-point", "Virtualization",
+    "Control protection", "Reserved", "Reserved", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Hypervisor injection", "VMM communication",
+    "Security", "Reserved"
+};
+
+static void idt_set_gate(uint8_t vector, uint32_t handler) {
+    IdtEntry& entry = idt[vector];
+    entry.offset_low = (uint16_t)(handler & 0xFFFF);
+    entry.selector = KERNEL_CODE_SELECTOR;
+    entry.zero = 0;
+    entry.type_attr = IDT_INTERRUPT_GATE;
+    entry.offset_high = (uint16_t)(handler >> 16);
+}
+
+static void pic_remap() {
+    // ICW1: start the initialization sequence on both controllers
+    outb(PIC1_COMMAND, PIC_ICW1_INIT);
+    io_wait();
+    outb(PIC2_COMMAND, PIC_ICW1_INIT);
+    io_wait();
+
+    // ICW2: vector offsets
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);
+    io_wait();
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    io_wait();
+
+    // ICW3: slave on master IRQ2, slave cascade identity 2
+    outb(PIC1_DATA, 1 << IRQ_CASCADE);
+    io_wait();
+    outb(PIC2_DATA, IRQ_CASCADE);
+    io_wait();
+
+    // ICW4: 8086 mode
+    outb(PIC1_DATA, PIC_ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, PIC_ICW4_8086);
+    io_wait();
+
+    // Everything masked except the cascade line
+    outb(PIC1_DATA, (uint8_t)~(1 << IRQ_CASCADE));
+    outb(PIC2_DATA, 0xFF);
+}
+
+/**
+ * A line whose in-service bit is clear when its vector arrives was raised
+ * by noise on IRQ7/IRQ15 and must not be acknowledged on that controller.
+ */
+static bool is_spurious(uint8_t irq) {
+    if (irq != 7 && irq != 15) {
+        return false;
+    }
+    uint16_t port = (irq < 8) ? PIC1_COMMAND : PIC2_COMMAND;
+    outb(port, PIC_READ_ISR);
+    return (inb(port) & (1 << (irq & 7))) == 0;
+}
+
+static void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+void interrupts_init() {
+    pic_remap();
+    for (uint32_t i = 0; i < IRQ_COUNT; ++i) {
+        irq_handlers[i] = nullptr;
+    }
+    for (uint32_t i = 0; i < LOCAL_VECTOR_COUNT; ++i) {
+        local_handlers[i] = nullptr;
+    }
+    for (uint32_t vector = 0; vector < IDT_VECTORS; ++vector) {
+        idt_set_gate((uint8_t)vector, isr_table[vector]);
+    }
+    idt_set_gate(VECTOR_SPURIOUS, (uint32_t)isr_spurious);
+}
+
+void interrupts_load_idt() {
+    IdtPointer ptr = { sizeof(IdtEntry) * 256 - 1, (uint32_t)idt };
+    __asm__ __volatile__("lidt %0" : : "m"(ptr));
+}
+
+void irq_mask(uint8_t irq) {
+    uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
+    uint32_t flags = irq_save();
+    outb(port, inb(port) | (uint8_t)(1 << (irq & 7)));
+    irq_restore(flags);
+}
+
+void irq_unmask(uint8_t irq) {
+    uint16_t port = (irq < 8) ? PIC1_DATA : PIC2_DATA;
+    uint32_t flags = irq_save();
+    outb(port, inb(port) & (uint8_t)~(1 << (irq & 7)));
+    irq_restore(flags);
+}
+
+void irq_register(uint8_t irq, IrqHandler handler) {
+    if (irq >= IRQ_COUNT) {
+        return;
+    }
+    irq_handlers[irq] = handler;
+    irq_unmask(irq);
+}
+
+void local_vector_register(uint8_t vector, IrqHandler handler) {
+    if (vector < LOCAL_VECTOR_BASE || vector >= LOCAL_VECTOR_BASE + LOCAL_VECTOR_COUNT) {
+        return;
+    }
+    local_handlers[vector - LOCAL_VECTOR_BASE] = handler;
+}
+
+__attribute__((noreturn)) static void fatal_exception(InterruptFrame* frame) {
+    const char* name = exception_names[frame->vector & 31];
+    klog.logf(LOG_ERROR, "EXCEPTION %u (%s) err=0x%x eip=%08x cs=%04x eflags=%08x",
+              frame->vector, name, frame->error_code, frame->eip, frame->cs, frame->eflags);
+    klog.logf(LOG_ERROR, "eax=%08x ebx=%08x ecx=%08x edx=%08x esi=%08x edi=%08x ebp=%08x",
+              frame->eax, frame->ebx, frame->ecx, frame->edx, frame->esi, frame->edi, frame->ebp);
+    kprintf("\n*** EXCEPTION %u: %s at EIP=%08x - system halted\n", frame->vector, name, frame->eip);
+    serial.flush();
+
+    for (;;) {
+        __asm__ __volatile__("cli; hlt");
+    }
+}
+
+KSTAT_COUNTER(stat_irqs, "irq.handled");
+KSTAT_COUNTER(stat_spurious_irqs, "irq.spurious");
+
+extern "C" void interrupt_dispatch(InterruptFrame* frame) {
+    if (frame->vector < IRQ_BASE_VECTOR) {
+        fatal_exception(frame);
+    }
+
+    if (frame->vector >= LOCAL_VECTOR_BASE) {
+        if (frame->vector == VECTOR_LAPIC_TIMER) {
+            profile_tick(frame);
+        }
+        TRACE_BEGIN("irq", frame->vector);
+        IrqHandler handler = local_handlers[frame->vector - LOCAL_VECTOR_BASE];
+        if (handler) {
+            handler(frame);
+        }
+        TRACE_END("irq");
+        lapic_eoi();
+        sched_irq_exit();
+        return;
+    }
+
+    uint8_t irq = (uint8_t)(frame->vector - IRQ_BASE_VECTOR);
+    if (is_spurious(irq)) {
+        kstat_inc(stat_spurious_irqs);
+        // A spurious IRQ15 was still a real cascade interrupt on the master
+        if (irq == 15) {
+            outb(PIC1_COMMAND, PIC_EOI);
+        }
+        return;
+    }
+
+    kstat_inc(stat_irqs);
+    if (irq == IRQ_TIMER) {
+        profile_tick(frame);
+    }
+    TRACE_BEGIN("irq", frame->vector);
+    IrqHandler handler = irq_handlers[irq];
+    if (handler) {
+        handler(frame);
+    }
+    TRACE_END("irq");
+    pic_send_eoi(irq);
+
+    // Only after the EOI: the next thread may run for a whole time slice
+    sched_irq_exit();
+}
@@ -0,0 +1,57 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include "types.h"
+
+/*
+ * Interrupt descriptor table and 8259 PIC management
+ * --------------------------------------------------
+ * - crt0 fills all 256 IDT vectors with a halting stub; interrupts_init()
+ *   replaces vectors 0-48 with the entry stubs from isr.s
+ * - The master/slave PICs are remapped to vectors 0x20-0x2F so IRQs no
+ *   longer collide with CPU exceptions, and every line starts masked
+ * - Drivers claim a line with irq_register(), which also unmasks it
+ * - Vectors from LOCAL_VECTOR_BASE up are raised by the local APIC of the
+ *   CPU that takes them (its timer) and are acknowledged there, not at the
+ *   8259. The APIC's spurious vector 0xFF returns without an EOI
+ */
+
+#define IRQ_BASE_VECTOR 0x20
+#define IRQ_COUNT       16
+
+#define IRQ_TIMER       0
+#define IRQ_KEYBOARD    1
+#define IRQ_CASCADE     2
+#define IRQ_COM1        4
+
+#define LOCAL_VECTOR_BASE   0x30
+#define LOCAL_VECTOR_COUNT  1
+#define VECTOR_LAPIC_TIMER  0x30
+#define VECTOR_SPURIOUS     0xFF
+
+// Register image pushed by isr.s (pushal, then the stub's vector/error code,
+// then the CPU's iret frame)
+struct InterruptFrame {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error_code;
+    uint32_t eip, cs, eflags;
+} __attribute__((packed));
+
+typedef void (*IrqHandler)(InterruptFrame* frame);
+
+void interrupts_init();
+void irq_register(uint8_t irq, IrqHandler handler);
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
+void local_vector_register(uint8_t vector, IrqHandler handler);
+
+// Load the shared IDT on an application processor
+void interrupts_load_idt();
+
+static inline void interrupts_enable()  { __asm__ __volatile__("sti" : : : "memory"); }
+static inline void interrupts_disable() { __asm__ __volatile__("cli" : : : "memory"); }
+
+extern "C" void interrupt_dispatch(InterruptFrame* frame);
+
+#endif // INTERRUPTS_H
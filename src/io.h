@@ -0,0 +1,58 @@
+#ifndef IO_H
+#define IO_H
+
+#include "types.h"
+
+/*
+ * x86 port I/O and interrupt-flag helpers shared by the device drivers.
+ */
+
+/**
+ * Read a byte from an I/O port
+ * @param port The port address to read from
+ * @return The byte read from the port
+ */
+static inline uint8_t inb(uint16_t port) {
+    uint8_t result;
+    __asm__ __volatile__("inb %1, %0" : "=a"(result) : "Nd"(port));
+    return result;
+}
+
+/**
+ * Write a byte to an I/O port
+ * @param port The port address to write to
+ * @param value The byte to write
+ */
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+/**
+ * Short delay for devices that need time between port writes (8259 setup).
+ * Port 0x80 is the POST diagnostic port and is safe to write.
+ */
+static inline void io_wait() {
+    outb(0x80, 0);
+}
+
+#define EFLAGS_IF 0x200  // interrupt enable flag
+
+/**
+ * Disable interrupts and return the previous EFLAGS so the caller can
+ * restore them with irq_restore(). Safe to nest.
+ */
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    __asm__ __volatile__("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/**
+ * Restore the interrupt flag saved by irq_save()
+ * @param flags Value returned by the matching irq_save()
+ */
+static inline void irq_restore(uint32_t flags) {
+    __asm__ __volatile__("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+#endif // IO_H
@@ -0,0 +1,73 @@
+# ============================================================================
+# RusticOS - Interrupt entry/exit stubs
+# ----------------------------------------------------------------------------
+# Vectors 0-31 are CPU exceptions, 32-47 the remapped 8259 IRQs and 48 the
+# local APIC timer. Every stub
+# pushes a uniform (error code, vector) pair and jumps to isr_common, which
+# saves the general registers and hands an InterruptFrame* (src/interrupts.h)
+# to interrupt_dispatch.
+# ============================================================================
+
+.extern interrupt_dispatch
+.global isr_table
+.global isr_spurious
+
+.section .text
+.code32
+
+# Exception without a CPU-pushed error code: push a dummy 0
+.macro ISR_NOERR num
+.align 4
+isr_\num:
+    pushl $0
+    pushl $\num
+    jmp isr_common
+.endm
+
+# Exception where the CPU already pushed an error code
+.macro ISR_ERR num
+.align 4
+isr_\num:
+    pushl $\num
+    jmp isr_common
+.endm
+
+.irp num, 0,1,2,3,4,5,6,7,9,15,16,18,19,20,22,23,24,25,26,27,28,31
+ISR_NOERR \num
+.endr
+
+.irp num, 8,10,11,12,13,14,17,21,29,30
+ISR_ERR \num
+.endr
+
+# Hardware IRQs 0-15 -> vectors 32-47
+.irp num, 32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47
+ISR_NOERR \num
+.endr
+
+# Local APIC vectors (see LOCAL_VECTOR_BASE)
+ISR_NOERR 48
+
+# Spurious local APIC interrupt: nothing to handle and no EOI to send
+.align 4
+isr_spurious:
+    iret
+
+.align 16
+isr_common:
+    pushal
+    cld
+    pushl %esp                  # InterruptFrame*
+    call interrupt_dispatch
+    addl $4, %esp
+    popal
+    addl $8, %esp               # drop vector and error code
+    iret
+
+# Stub addresses in vector order, installed into the IDT by interrupts_init
+.section .rodata
+.align 4
+isr_table:
+.irp num, 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,41,42,43,44,45,46,47,48
+    .long isr_\num
+.endr
@@ -3,12 +3,15 @@
  * 
  * This module handles:
  * - Hardware initialization (serial, VGA, keyboard)
+ * - Boot logging through the kernel log (mirrored to COM1)
  * - Kernel startup and main event loop
  * - Command-line interface integration
- * - Keyboard input polling and processing
+ * - Interrupt setup (PIC remap, IRQ1 keyboard, IRQ4 serial)
+ * - Keyboard event processing
  * 
- * The kernel runs in protected mode with no interrupts (polling-based).
- * All hardware access is done via direct I/O port operations.
+ * The kernel runs in protected mode. Device input arrives through IRQ
+ * handlers; the main loop processes queued events and halts the CPU
+ * until the next interrupt when there is nothing to do.
  */
 
 #include "terminal.h"
@@ -16,6 +19,19 @@
 #include "keyboard.h"
 #include "filesystem.h"
 #include "command.h"
+#include "io.h"
+#include "serial.h"
+#include "klog.h"
+#include "fbconsole.h"
+#include "vconsole.h"
+#include "interrupts.h"
+#include "clock.h"
+#include "kstats.h"
+#include "thread.h"
+#include "smp.h"
+#include "workqueue.h"
+#include "bootinfo.h"
+#include "bootstat.h"
 #include <cstring>
 
 /* ============================================================================
@@ -35,33 +51,27 @@
 #define CRTC_CURSOR_HIGH 0x0E  // Cursor location high byte
 #define CRTC_CURSOR_LOW  0x0F  // Cursor location low byte
 
-// Serial Port (COM1) Constants
-#define SERIAL_PORT     0x3F8
-#define SERIAL_BAUD_DIV 0x03   // Divisor for 115200 baud
-#define SERIAL_IER      (SERIAL_PORT + 1)
-#define SERIAL_FCR      (SERIAL_PORT + 2)
-#define SERIAL_LCR      (SERIAL_PORT + 3)
-
 // PS/2 Keyboard Port Constants
 #define KBD_DATA_PORT   0x60
 #define KBD_STAT_PORT   0x64
 #define KBD_STATUS_HAVE_DATA 0x01
+#define KBD_STATUS_INPUT_FULL 0x02
+#define KBD_ACK         0xFA
 
 // Keyboard Commands
 #define KBD_CMD_DISABLE 0xF5
 #define KBD_CMD_SET_SCANCODE 0xF0
 #define KBD_SCANCODE_SET_1 0x01
 #define KBD_CMD_ENABLE  0xF4
-#define KBD_SCANCODE_RELEASE 0x80
 
 // VGA Color Attributes (BLACK bg, BLACK text)
 #define VGA_BLACK_BLACK 0x0700
 // VGA Color Attributes (GREEN bg, BLACK text)
 #define VGA_GREEN_BLACK 0x2000
 
-// Timing Constants (loop counts for delays)
-#define DELAY_SHORT     10000
-#define DELAY_MEDIUM    100000
+// Timing Constants (bounded waits on device status registers)
+#define KBD_TIMEOUT_US   50000
+#define KBD_POLL_STEP_US 10
 
 /* ============================================================================
  * GLOBAL VARIABLES
@@ -73,30 +83,6 @@ extern CommandSystem command_system;
 static uint16_t prompt_start_x = 0;
 static uint16_t prompt_start_y = 0;
 
-/* ============================================================================
- * INLINE I/O PORT OPERATIONS
- * ============================================================================ */
-
-/**
- * Read a byte from an I/O port
- * @param port The port address to read from
- * @return The byte read from the port
- */
-static inline uint8_t inb(uint16_t port) {
-    uint8_t result;
-    __asm__ __volatile__("inb %1, %0" : "=a"(result) : "Nd"(port));
-    return result;
-}
-
-/**
- * Write a byte to an I/O port
- * @param port The port address to write to
- * @param value The byte to write
- */
-static inline void outb(uint16_t port, uint8_t value) {
-    __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"(port));
-}
-
 /* ============================================================================
  * SIMPLE VGA TEXT PRINTER
  * ============================================================================ */
@@ -126,84 +112,68 @@ static void print_at_row(int row, const char* text, uint16_t color) {
  * ============================================================================ */
 
 /**
- * PS/2 Keyboard scan code to ASCII conversion table
- * Maps PS/2 scan codes to ASCII characters
- */
-static const char scancode_to_ascii[] = {
-    // 0x00-0x09
-    0, 0, '1', '2', '3', '4', '5', '6', '7', '8',
-    // 0x0A-0x13
-    '9', '0', 0, 0, '\b', 0, 'q', 'w', 'e', 'r',
-    // 0x14-0x1D
-    't', 'y', 'u', 'i', 'o', 'p', 0, 0, '\n', 0,
-    // 0x1E-0x27
-    'a', 's', 'd', 'f', 'g', 'h', 'j', 'k',
-    // 0x28-0x31
-    'l', 0, 0, 0, 0, 0, 'z', 'x', 'c', 'v',
-    // 0x32-0x3B
-    'b', 'n', 'm', 0, 0, 0, ' ', 0
-};
-
-/**
- * Convert PS/2 scan code to ASCII character
- * Handles key press/release detection
- * 
- * @param scan_code Raw PS/2 scan code from keyboard
- * @return ASCII character (0 if invalid/release code)
+ * Deliver one key event to the console layer or the shell
+ *
+ * Console hot keys (Alt+F1..F4, Shift+PageUp/PageDown) are handled by the
+ * virtual console manager. Everything else is shell input, which is only
+ * accepted while the shell console is on display.
+ *
+ * @param event Key press decoded by the keyboard driver
  */
-static char scancode_to_char(uint8_t scan_code) {
-    // Check if this is a key release event (high bit set)
-    if (scan_code & KBD_SCANCODE_RELEASE) {
-        return 0;  // Ignore key releases
+static void dispatch_key_event(const KeyEvent& event) {
+    if (vconsoles.handle_key(event)) {
+        return;
     }
-    
-    // Get the base scan code
-    uint8_t key_code = scan_code & 0x7F;
-    
-    // Check bounds
-    if (key_code >= sizeof(scancode_to_ascii)) {
-        return 0;
+    if (vconsoles.current_index() != VC_SHELL || event.ascii == 0) {
+        return;
     }
-    
-    return scancode_to_ascii[key_code];
-}
 
-/**
- * Poll keyboard for input and process any keypresses
- * 
- * This function:
- * - Checks if keyboard has data available
- * - Reads the scan code from the keyboard
- * - Converts scan code to ASCII
- * - Sends input to the command system
- * - Executes commands when user presses Enter
- * 
- * @return true if a key was processed, false if no key available
- */
-bool poll_keyboard() {
-    // Check if keyboard has data available
-    if ((inb(KBD_STAT_PORT) & KBD_STATUS_HAVE_DATA) == 0) {
-        return false;  // No data in keyboard buffer
-    }
-    
-    uint8_t scan_code = inb(KBD_DATA_PORT);
-    char ascii = scancode_to_char(scan_code);
-    
-    if (ascii == 0) {
-        return false;  // Invalid or release code
-    }
-    
     // Send the input character to the command system for processing
-    command_system.process_input(ascii);
-    
+    command_system.process_input((char)event.ascii);
+
     // Check if a complete command has been entered (user pressed Enter)
     if (command_system.is_input_complete()) {
         command_system.execute_command();
         command_system.reset_input();
         terminal.write(">");  // Display prompt for next command
     }
-    
-    return true;
+}
+
+// The main thread sleeps here while there is no keyboard input
+static WaitQueue input_wait;
+
+/**
+ * IRQ1 handler: read the scan code and let the keyboard driver decode and
+ * queue it. Event dispatch happens later in the main thread, which is woken.
+ */
+static void keyboard_irq(InterruptFrame*) {
+    keyboard.handle_interrupt(inb(KBD_DATA_PORT));
+    input_wait.wake_all();
+}
+
+/**
+ * IRQ4 handler: refill the UART transmit FIFO from the serial TX ring
+ */
+static void serial_irq(InterruptFrame*) {
+    serial.handle_interrupt();
+}
+
+KSTAT_COUNTER(stat_key_events, "kbd.events");
+
+/**
+ * Process every key event queued by the keyboard IRQ handler
+ * 
+ * @return true if a key was processed, false if the queue was empty
+ */
+bool process_keyboard_events() {
+    KeyEvent event;
+    bool processed = false;
+    while (keyboard.get_key_event(event)) {
+        kstat_inc(stat_key_events);
+        dispatch_key_event(event);
+        processed = true;
+    }
+    return processed;
 }
 
 /* ============================================================================
@@ -270,41 +240,6 @@ static void write_title() {
  * HARDWARE INITIALIZATION
  * ============================================================================ */
 
-/**
- * Write a string to serial port for debugging
- * 
- * Used during boot to provide status messages.
- * Output appears on COM1 (115200 baud).
- * 
- * @param str Null-terminated string to output
- */
-static void serial_write(const char* str) {
-    while (*str) {
-        outb(SERIAL_PORT, *str);
-        // Small delay to ensure output completes
-        for (volatile int i = 0; i < DELAY_SHORT; i++);
-        str++;
-    }
-}
-
-/**
- * Initialize serial port (COM1) for debugging output
- * 
- * Configuration:
- * - Baud rate: 115200
- * - Data bits: 8
- * - Parity: None
- * - Stop bits: 1
- */
-static void init_serial() {
-    outb(SERIAL_IER, 0x00);        // Disable all interrupts
-    outb(SERIAL_LCR, 0x80);        // Enable DLAB (set baud rate divisor)
-    outb(SERIAL_PORT, SERIAL_BAUD_DIV);     // Set divisor low byte (115200 baud)
-    outb(SERIAL_IER, 0x00);        // Set divisor high byte to 0
-    outb(SERIAL_LCR, 0x03);        // Disable DLAB, set 8 bits, no parity, 1 stop
-    outb(SERIAL_FCR, 0xC7);        // Enable FIFO, clear it, set level to 14 bytes
-}
-
 /**
  * Initialize VGA text mode display for QEMU compatibility
  * 
@@ -325,42 +260,50 @@ static void init_vga() {
         vga[i] = (uint16_t)' ' | VGA_BLACK_BLACK;  // BLACK text on BLACK bg
     }
     
-    // Small delay to ensure writes are processed
-    for (volatile int delay = 0; delay < DELAY_MEDIUM; delay++);
-    
     // Step 2: Access VGA status register to confirm display is active
     uint8_t status = inb(VGA_STATUS_PORT);
     (void)status;  // Suppress unused variable warning
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
     
     // Step 3: Set initial cursor position to 0,0 via CRTC registers
     outb(VGA_CRTC_INDEX, CRTC_CURSOR_HIGH);
     outb(VGA_CRTC_DATA, 0x00);
     outb(VGA_CRTC_INDEX, CRTC_CURSOR_LOW);
     outb(VGA_CRTC_DATA, 0x00);
-    
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
 }
 
 /**
- * Set cursor position via VGA CRTC registers
- * Position is calculated as: row * 80 + col
+ * Wait until the PS/2 controller status matches, giving up after
+ * KBD_TIMEOUT_US so a missing or wedged controller cannot hang boot
  * 
- * @param row Row number (0-24)
- * @param col Column number (0-79)
+ * @param mask Status bits to test
+ * @param expected Required value of those bits
+ * @return true if the status matched before the timeout
  */
-static void set_cursor_position(uint8_t row, uint8_t col) {
-    uint16_t pos = row * VGA_WIDTH + col;
-    
-    // Set high byte of cursor position
-    outb(VGA_CRTC_INDEX, CRTC_CURSOR_HIGH);
-    outb(VGA_CRTC_DATA, (uint8_t)(pos >> 8));
-    
-    // Set low byte of cursor position
-    outb(VGA_CRTC_INDEX, CRTC_CURSOR_LOW);
-    outb(VGA_CRTC_DATA, (uint8_t)(pos & 0xFF));
-    
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
+static bool kbd_wait_status(uint8_t mask, uint8_t expected) {
+    for (uint32_t waited = 0; waited < KBD_TIMEOUT_US; waited += KBD_POLL_STEP_US) {
+        if ((inb(KBD_STAT_PORT) & mask) == expected) {
+            return true;
+        }
+        udelay(KBD_POLL_STEP_US);
+    }
+    return false;
+}
+
+/**
+ * Send one byte to the keyboard and wait for its ACK
+ * 
+ * @param byte Command or data byte
+ * @return true if the keyboard acknowledged it
+ */
+static bool kbd_send(uint8_t byte) {
+    if (!kbd_wait_status(KBD_STATUS_INPUT_FULL, 0)) {
+        return false;
+    }
+    outb(KBD_DATA_PORT, byte);
+    if (!kbd_wait_status(KBD_STATUS_HAVE_DATA, KBD_STATUS_HAVE_DATA)) {
+        return false;
+    }
+    return inb(KBD_DATA_PORT) == KBD_ACK;
 }
 
 /**
@@ -374,35 +317,43 @@ static void set_cursor_position(uint8_t row, uint8_t col) {
  * This ensures QEMU and real hardware use consistent scan code format.
  */
 static void init_keyboard() {
-    // Wait for keyboard controller to be ready
-    for (volatile int i = 0; i < DELAY_MEDIUM; i++);
-    
-    // Command: Disable scanning (0xF5)
-    outb(KBD_DATA_PORT, KBD_CMD_DISABLE);
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    
-    // Read and discard the ACK response
-    uint8_t response = inb(KBD_DATA_PORT);
-    (void)response;  // Suppress unused variable warning
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    
-    // Command: Set scan code set 1 (0xF0)
-    outb(KBD_DATA_PORT, KBD_CMD_SET_SCANCODE);
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    inb(KBD_DATA_PORT);  // Read ACK
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    
-    // Subcommand: Use scan code set 1 (0x01)
-    outb(KBD_DATA_PORT, KBD_SCANCODE_SET_1);
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    inb(KBD_DATA_PORT);  // Read ACK
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    
-    // Command: Enable scanning (0xF4)
-    outb(KBD_DATA_PORT, KBD_CMD_ENABLE);
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
-    inb(KBD_DATA_PORT);  // Read ACK
-    for (volatile int i = 0; i < DELAY_SHORT; i++);
+    keyboard.init();
+
+    // Drop any stale bytes so the first read below is the ACK
+    while (inb(KBD_STAT_PORT) & KBD_STATUS_HAVE_DATA) {
+        inb(KBD_DATA_PORT);
+    }
+
+    bool ok = kbd_send(KBD_CMD_DISABLE)
+           && kbd_send(KBD_CMD_SET_SCANCODE)
+           && kbd_send(KBD_SCANCODE_SET_1)
+           && kbd_send(KBD_CMD_ENABLE);
+    if (!ok) {
+        klog.warn("Keyboard did not acknowledge setup; using controller defaults");
+        kbd_send(KBD_CMD_ENABLE);
+    }
+
+    // Discard anything still latched so IRQ1 starts from an empty buffer
+    while (inb(KBD_STAT_PORT) & KBD_STATUS_HAVE_DATA) {
+        inb(KBD_DATA_PORT);
+    }
+
+    irq_register(IRQ_KEYBOARD, keyboard_irq);
+}
+
+/**
+ * Block the main thread until keyboard input is queued; other threads (or
+ * the idle thread's HLT) run meanwhile
+ * 
+ * The check runs with interrupts disabled so an IRQ landing between the
+ * check and the block cannot be missed.
+ */
+static void wait_for_input() {
+    interrupts_disable();
+    while (!keyboard.has_events()) {
+        input_wait.wait();
+    }
+    interrupts_enable();
 }
 
 /* ============================================================================
@@ -413,36 +364,69 @@ static void init_keyboard() {
  * Kernel main entry point
  * 
  * Initialization sequence:
- * 1. Serial port setup for debugging
+ * 1. Serial port and kernel log setup
  * 2. VGA display initialization
  * 3. Terminal display setup
  * 4. Welcome messages display
- * 5. Command prompt display
- * 6. Keyboard controller setup
- * 7. Main event loop (keyboard polling)
- * 
- * NOTE: The kernel runs in protected mode with no interrupts.
- * All I/O is polling-based.
+ * 5. Command prompt display (and /init.rc, if present)
+ * 6. Keyboard controller setup and IRQ routing
+ * 7. Main event loop (process events, HLT when idle)
  */
 extern "C" void kernel_main() {
-    // Initialize serial port for debug output
-    init_serial();
-    serial_write("===== KERNEL STARTED =====\n");
+    // Close the stages crt0.s stamped; each bootstat_mark() ends one more
+    bootstat_init();
+
+    // Kernel GDT and the per-CPU %gs segment that cpu_index() reads
+    smp_boot_cpu_init();
+
+    // Copy the Multiboot information before anything can overwrite it
+    bootinfo_init();
+
+    // Initialize serial port and kernel log for debug output
+    serial.init();
+    klog.init();
+    bootstat_mark("serial+klog");
+    klog.info("===== KERNEL STARTED =====");
+    klog.logf(LOG_INFO, "Booted by %s, %u modules, cmdline '%s'",
+              bootinfo_source_name(), bootinfo().module_count, bootinfo().cmdline);
+
+    // Remap the PIC and install the exception/IRQ stubs (IRQs stay off)
+    interrupts_init();
+    bootstat_mark("interrupts");
+
+    // Calibrate the TSC so every later wait is in real time units
+    clock_init();
+    if (clock_has_tsc()) {
+        klog.logf(LOG_INFO, "TSC calibrated: %u kHz", clock_tsc_khz());
+    } else {
+        klog.warn("No usable TSC; delays fall back to PIT channel 2");
+    }
+    bootstat_mark("clock");
+
+    // From here on kernel_main is the "main" thread
+    threads_init();
+    work_init();
+
+    // Start the other CPUs; they idle until there is work to steal
+    smp_init();
+    bootstat_mark("threads+smp");
     
     // Initialize VGA display (CRITICAL: write buffer before register access)
-    serial_write("Initializing VGA display...\n");
+    klog.info("Initializing VGA display...");
     init_vga();
+    bootstat_mark("vga");
     
     // Write the green title bar to row 0
-    serial_write("Writing title bar...\n");
+    klog.info("Writing title bar...");
     for (int i = 0; i < VGA_WIDTH; i++) {
         VGA_BUFFER[i] = (uint16_t)' ' | VGA_GREEN_BLACK;
     }
 
     write_title();
+    bootstat_mark("title");
     
     // Write text directly to VGA using simple print function
-    serial_write("Writing welcome text...\n");
+    klog.info("Writing welcome text...");
     uint16_t attr = VGA_ATTR(TerminalColor::GREEN, TerminalColor::BLACK);
     
     // Row 2: Welcome message
@@ -456,22 +440,61 @@ extern "C" void kernel_main() {
     
     // Row 6: Command prompt
     print_at_row(6, ">", attr);
+
+    // With a VESA framebuffer the text buffer is not scanned out; render the
+    // same screen on the pixel console and mirror terminal output to it.
+    // Only boot/loader.asm fills in the handoff block.
+    if (bootinfo().source == BOOT_SOURCE_LOADER && fbcon.init((const VbeHandoff*)VBE_HANDOFF_ADDR)) {
+        fbcon.setColor(TerminalColor::BLACK, TerminalColor::GREEN);
+        fbcon.write("RusticOS        Level:Kernel        Version:1.0.0\n\n");
+        fbcon.setColor(TerminalColor::GREEN, TerminalColor::BLACK);
+        fbcon.write("Welcome to RusticOS!\n"
+                    "Type 'help' for available commands.\n"
+                    "Root filesystem mounted at '/'\n\n>");
+        klog.logf(LOG_INFO, "Framebuffer console: %ux%u cells", fbcon.getColumns(), fbcon.getRows());
+    }
     
+    // Hand the screen to the shell console and route the log to its own
+    vconsoles.init();
+    terminal.setColor(TerminalColor::GREEN, TerminalColor::BLACK);
+    klog.setConsole(&vconsoles.get(VC_LOG));
+
     // Set cursor position to right after the '>' prompt (row 6, col 1)
-    set_cursor_position(6, 1);
-    
-    serial_write("Display ready.\n");
+    terminal.setCursor(1, 6);
+    
+    klog.info("Display ready.");
+    bootstat_mark("console");
+
+    // Boot modules (QEMU -initrd, GRUB module lines) become files
+    bootinfo_load_modules(filesystem);
+    bootstat_mark("fs mount");
+
+    // Run the boot script, if the filesystem provides one
+    if (filesystem.find_file("init.rc")) {
+        klog.info("Running /init.rc...");
+        terminal.write("\n");
+        command_system.run_script("init.rc");
+        terminal.write(">");
+        bootstat_mark("init.rc");
+    }
     
     // Initialize keyboard controller
-    serial_write("Initializing keyboard...\n");
+    klog.info("Initializing keyboard...");
     init_keyboard();
-    serial_write("===== KERNEL READY =====\n");
+    bootstat_mark("keyboard");
+
+    // Serial output is now drained by the THR-empty interrupt
+    irq_register(IRQ_COM1, serial_irq);
+    serial.enable_tx_interrupt();
+
+    interrupts_enable();
+    bootstat_mark("first prompt");
+    klog.info("===== KERNEL READY =====");
+    bootstat_report();
     
-    // Main kernel event loop - poll keyboard for input
+    // Main kernel event loop - handle queued input, then sleep
     while (true) {
-        poll_keyboard();
-        
-        // Small delay to prevent excessive CPU usage
-        for (volatile int i = 0; i < DELAY_SHORT; i++);
+        process_keyboard_events();
+        wait_for_input();
     }
 }
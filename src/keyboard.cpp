@@ -4,7 +4,7 @@
 static bool key_state[256];
 
 KeyboardDriver::KeyboardDriver()
-    : head(0), tail(0), shift_pressed(false), ctrl_pressed(false), alt_pressed(false)
+    : shift_pressed(false), ctrl_pressed(false), alt_pressed(false)
 {
     for (int i = 0; i < 256; ++i) {
         key_state[i] = false;
@@ -13,8 +13,7 @@ KeyboardDriver::KeyboardDriver()
 
 void KeyboardDriver::init()
 {
-    head = 0;
-    tail = 0;
+    events.reset();
     shift_pressed = false;
     ctrl_pressed = false;
     alt_pressed = false;
@@ -120,26 +119,15 @@ void KeyboardDriver::handle_interrupt(uint8_t scan_code)
         event.ctrl = ctrl_pressed;
         event.alt = alt_pressed;
 
-        // Push to circular buffer
-        uint32_t next = (head + 1) % KEYBOARD_BUFFER_SIZE;
-        if (next == tail) {
-            // Buffer full, drop oldest event
-            tail = (tail + 1) % KEYBOARD_BUFFER_SIZE;
-        }
-        buffer[head] = event;
-        head = next;
+        // Queue for the main loop; if it is full the newest key is dropped
+        // (and counted) rather than racing the consumer for the oldest slot
+        events.push(event);
     }
 }
 
 bool KeyboardDriver::get_key_event(KeyEvent& event)
 {
-    if (head == tail) {
-        return false; // Buffer empty
-    }
-
-    event = buffer[tail];
-    tail = (tail + 1) % KEYBOARD_BUFFER_SIZE;
-    return true;
+    return events.pop(event);
 }
 
 bool KeyboardDriver::is_key_pressed(uint8_t scan_code)
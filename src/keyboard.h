@@ -2,6 +2,7 @@
 #define KEYBOARD_H
 
 #include "types.h"
+#include "spsc_ring.h"
 
 // Key event structure used by terminal/keyboard code
 struct KeyEvent {
@@ -41,15 +42,15 @@ enum KeyCode {
     KEY_KEYPAD_MINUS = 0x4A, KEY_KEYPAD_4 = 0x4B, KEY_KEYPAD_5 = 0x4C,
     KEY_KEYPAD_6 = 0x4D, KEY_KEYPAD_PLUS = 0x4E, KEY_KEYPAD_1 = 0x4F,
     KEY_KEYPAD_2 = 0x50, KEY_KEYPAD_3 = 0x51, KEY_KEYPAD_0 = 0x52,
-    KEY_KEYPAD_DECIMAL = 0x53, KEY_F11 = 0x57, KEY_F12 = 0x58
+    KEY_KEYPAD_DECIMAL = 0x53, KEY_F11 = 0x57, KEY_F12 = 0x58,
+    // Extended (0xE0-prefixed) keys that share a code with the keypad
+    KEY_PAGE_UP = 0x49, KEY_PAGE_DOWN = 0x51
 };
 
 class KeyboardDriver {
 private:
     static const uint32_t KEYBOARD_BUFFER_SIZE = 256;
-    KeyEvent buffer[KEYBOARD_BUFFER_SIZE];
-    uint32_t head;
-    uint32_t tail;
+    SpscRing<KeyEvent, KEYBOARD_BUFFER_SIZE> events;   // IRQ1 -> main loop
     bool shift_pressed;
     bool ctrl_pressed;
     bool alt_pressed;
@@ -62,6 +63,8 @@ public:
     void init();
     void handle_interrupt(uint8_t scan_code);
     bool get_key_event(KeyEvent& event);
+    bool has_events() const { return !events.empty(); }
+    uint32_t dropped_events() const { return events.overflow_count(); }
     bool is_key_pressed(uint8_t scan_code);
     bool is_shift_pressed() const { return shift_pressed; }
     bool is_ctrl_pressed()  const { return ctrl_pressed; }
@@ -0,0 +1,158 @@
+/*
+ * RusticOS kernel log
+ * -------------------
+ * Records are stored in a power-of-two ring indexed by sequence number.
+ * Writers claim a sequence number with an atomic increment, so interrupt
+ * handlers can log while the main loop is in the middle of a record.
+ */
+
+#include "klog.h"
+#include "serial.h"
+#include "terminal.h"
+#include "kprintf.h"
+#include "stream.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "trace.h"
+
+KernelLog klog;
+
+static const char* const LEVEL_NAMES[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+const char* KernelLog::level_name(uint8_t level) {
+    return (level <= LOG_ERROR) ? LEVEL_NAMES[level] : "?";
+}
+
+void KernelLog::init(uint8_t min_serial_level) {
+    next_seq = 0;
+    serial_level = min_serial_level;
+    console = nullptr;
+    console_seq = 0;
+    console_busy = 0;
+}
+
+uint8_t KernelLog::setSerialLevel(uint8_t level) {
+    uint8_t previous = serial_level;
+    __atomic_store_n(&serial_level, level, __ATOMIC_RELAXED);
+    return previous;
+}
+
+void KernelLog::setConsole(Terminal* terminal) {
+    console = terminal;
+    if (console) {
+        TerminalStream out(*console);
+        dump(out);
+        console_seq = next_seq;
+    }
+}
+
+static void console_flush_work(void* arg) {
+    ((KernelLog*)arg)->flushConsole();
+}
+
+void KernelLog::flushConsole() {
+    // An IRQ that logs during an inline flush leaves its record to the
+    // outer loop, which rereads next_seq
+    if (!console || __atomic_exchange_n(&console_busy, 1, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    TRACE_SCOPE("klog.flush", 0);
+
+    uint32_t seq = console_seq;
+    while (seq != __atomic_load_n(&next_seq, __ATOMIC_ACQUIRE)) {
+        if (next_seq - seq > LOG_RECORDS) {
+            seq = next_seq - LOG_RECORDS;   // the ring lapped the console
+        }
+        const LogRecord& rec = records[seq & (LOG_RECORDS - 1)];
+        int32_t behind = (int32_t)(__atomic_load_n(&rec.seq, __ATOMIC_ACQUIRE) - seq);
+        if (behind > 0) {
+            seq++;                          // overwritten meanwhile
+            continue;
+        }
+        if (behind < 0) {
+            break;                          // claimed, seq not stored yet; its commit flushes again
+        }
+        uint8_t length = __atomic_load_n(&rec.length, __ATOMIC_ACQUIRE);
+        if (length == 0) {
+            break;                          // still being written; its commit flushes again
+        }
+
+        // "main" draws on the same terminal from the same CPU
+        preempt_disable();
+        console->write("[");
+        console->write(level_name(rec.level));
+        console->write("] ");
+        console->write(rec.text, length);
+        preempt_enable();
+        seq++;
+    }
+    console_seq = seq;
+    __atomic_store_n(&console_busy, 0, __ATOMIC_RELEASE);
+}
+
+LogRecord& KernelLog::claim(uint8_t level) {
+    uint32_t seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    LogRecord& rec = records[seq & (LOG_RECORDS - 1)];
+    // Uncommitted until commit() stores the length (see flushConsole)
+    rec.length = 0;
+    rec.level = level;
+    __atomic_store_n(&rec.seq, seq, __ATOMIC_RELEASE);
+    return rec;
+}
+
+void KernelLog::commit(LogRecord& rec, uint32_t length) {
+    if (length > LOG_MESSAGE_MAX) length = LOG_MESSAGE_MAX;
+    rec.text[length] = '\n';
+    rec.text[length + 1] = '\0';
+    __atomic_store_n(&rec.length, (uint8_t)(length + 1), __ATOMIC_RELEASE);
+
+    if (rec.level >= __atomic_load_n(&serial_level, __ATOMIC_RELAXED)) {
+        serial.write(rec.text, rec.length);
+    }
+    if (console) {
+        if (work_ready()) {
+            work_queue_once(console_flush_work, this);
+        } else {
+            flushConsole();
+        }
+    }
+}
+
+void KernelLog::log(uint8_t level, const char* message) {
+    LogRecord& rec = claim(level);
+    uint32_t len = 0;
+    while (message[len] && len < LOG_MESSAGE_MAX) {
+        rec.text[len] = message[len];
+        len++;
+    }
+    commit(rec, len);
+}
+
+void KernelLog::logf(uint8_t level, const char* fmt, ...) {
+    LogRecord& rec = claim(level);
+    va_list args;
+    va_start(args, fmt);
+    int len = kvsnprintf(rec.text, LOG_MESSAGE_MAX + 1, fmt, args);
+    va_end(args);
+    commit(rec, (uint32_t)len);
+}
+
+void KernelLog::dump(OutputStream& out, uint8_t min_level) {
+    uint32_t end = next_seq;
+    uint32_t start = (end > LOG_RECORDS) ? end - LOG_RECORDS : 0;
+
+    for (uint32_t seq = start; seq < end; ++seq) {
+        const LogRecord& rec = records[seq & (LOG_RECORDS - 1)];
+        if (__atomic_load_n(&rec.seq, __ATOMIC_ACQUIRE) != seq || rec.level < min_level) {
+            continue;   // overwritten meanwhile, or filtered out
+        }
+        uint8_t length = __atomic_load_n(&rec.length, __ATOMIC_ACQUIRE);
+        if (length == 0) {
+            continue;   // still being written (an IRQ or another CPU)
+        }
+        char line[32];
+        int n = ksnprintf(line, sizeof(line), "[%5u] %-5s ", seq, level_name(rec.level));
+        out.write(line, (uint32_t)n);
+        out.write(rec.text, length);
+    }
+}
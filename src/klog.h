@@ -0,0 +1,84 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include "types.h"
+
+class Terminal;
+class OutputStream;
+
+/*
+ * Kernel log (dmesg)
+ * ------------------
+ * - Fixed-size, leveled in-memory record ring; the oldest records are
+ *   overwritten once the ring wraps
+ * - Every record is mirrored to the serial console, which queues it in the
+ *   UART TX ring so logging never stalls on the line
+ * - Safe to call from interrupt context: slots are claimed atomically
+ * - The optional console view is drawn by the deferred-work thread once it
+ *   runs (see workqueue.h): a burst of records costs one queued flush, and
+ *   IRQ handlers that log no longer render text. Until then, and for
+ *   records the pool had no room for, it is drawn by the next flush
+ */
+
+enum LogLevel {
+    LOG_DEBUG = 0,
+    LOG_INFO  = 1,
+    LOG_WARN  = 2,
+    LOG_ERROR = 3
+};
+
+#define LOG_MESSAGE_MAX 120
+
+struct LogRecord {
+    uint32_t seq;                   // monotonically increasing record number
+    uint8_t level;
+    uint8_t length;
+    char text[LOG_MESSAGE_MAX + 2]; // NUL-terminated, truncated if needed
+};
+
+class KernelLog {
+private:
+    static const uint32_t LOG_RECORDS = 128;   // must be a power of two
+
+    LogRecord records[LOG_RECORDS];
+    uint32_t next_seq;
+    uint8_t serial_level;                       // minimum level mirrored to COM1
+    Terminal* console;                          // optional log view
+    uint32_t console_seq;                       // next record to draw there
+    uint32_t console_busy;                      // a flushConsole() is running
+
+    LogRecord& claim(uint8_t level);
+    void commit(LogRecord& rec, uint32_t length);
+
+public:
+    void init(uint8_t min_serial_level = LOG_DEBUG);
+
+    // Change the minimum level mirrored to COM1 and return the old one; a
+    // level above LOG_ERROR keeps the line free for binary dumps
+    uint8_t setSerialLevel(uint8_t level);
+
+    // Mirror records to a terminal (replays the retained records first)
+    void setConsole(Terminal* terminal);
+
+    // Draw every committed record the console has not shown yet
+    void flushConsole();
+
+    void log(uint8_t level, const char* message);
+    void debug(const char* message) { log(LOG_DEBUG, message); }
+    void info(const char* message)  { log(LOG_INFO, message); }
+    void warn(const char* message)  { log(LOG_WARN, message); }
+    void error(const char* message) { log(LOG_ERROR, message); }
+
+    // Formatted variant (see kprintf.h for the supported conversions)
+    void logf(uint8_t level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // Write every retained record at or above min_level to a stream
+    void dump(OutputStream& out, uint8_t min_level = LOG_DEBUG);
+
+    uint32_t count() const { return next_seq; }
+    static const char* level_name(uint8_t level);
+};
+
+extern KernelLog klog;
+
+#endif // KLOG_H
@@ -0,0 +1,313 @@
+/*
+ * RusticOS kernel printf
+ * ----------------------
+ * A single formatting engine (kvformat) drives every front end. Output is
+ * collected in a FormatBuffer: for ksnprintf that is the caller's buffer,
+ * for kprintf/kserial_printf it is a 128-byte stack buffer flushed to the
+ * terminal or serial TX ring whenever it fills.
+ *
+ * Decimal conversion emits two digits per division by 100 from a digit-pair
+ * table (the compiler turns the constant division into a multiply); 64-bit
+ * values are split into 9-digit chunks so the inner loop stays 32-bit.
+ */
+
+#include "kprintf.h"
+#include "terminal.h"
+#include "serial.h"
+
+static const char DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char HEX_LOWER[] = "0123456789abcdef";
+static const char HEX_UPPER[] = "0123456789ABCDEF";
+
+// ----------------------------------------------------------------------------
+// Integer conversion
+// ----------------------------------------------------------------------------
+static uint32_t format_u32(char* end, uint32_t value) {
+    char* p = end;
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        p[0] = DIGIT_PAIRS[pair];
+        p[1] = DIGIT_PAIRS[pair + 1];
+    }
+    if (value >= 10) {
+        p -= 2;
+        p[0] = DIGIT_PAIRS[value * 2];
+        p[1] = DIGIT_PAIRS[value * 2 + 1];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return (uint32_t)(end - p);
+}
+
+uint32_t kformat_u64(char* end, uint64_t value) {
+    char* p = end;
+    while (value > 0xFFFFFFFFull) {
+        // Peel off the low nine digits with one 64-bit division
+        uint64_t quotient = value / 1000000000u;
+        uint32_t chunk = (uint32_t)(value - quotient * 1000000000u);
+        value = quotient;
+        uint32_t n = format_u32(p, chunk);
+        p -= n;
+        while (n++ < 9) *--p = '0';
+    }
+    p -= format_u32(p, (uint32_t)value);
+    return (uint32_t)(end - p);
+}
+
+uint32_t kformat_hex(char* end, uint64_t value, bool upper) {
+    const char* digits = upper ? HEX_UPPER : HEX_LOWER;
+    char* p = end;
+    do {
+        *--p = digits[value & 0xF];
+        value >>= 4;
+    } while (value);
+    return (uint32_t)(end - p);
+}
+
+// ----------------------------------------------------------------------------
+// Output staging
+// ----------------------------------------------------------------------------
+struct FormatBuffer {
+    char* data;
+    uint32_t capacity;      // usable bytes in data
+    uint32_t length;        // bytes currently staged
+    uint32_t total;         // bytes produced overall
+    KPrintSink sink;        // null: truncate instead of flushing
+    void* context;
+};
+
+static void fb_flush(FormatBuffer& fb) {
+    if (fb.sink && fb.length) {
+        fb.sink(fb.context, fb.data, fb.length);
+        fb.length = 0;
+    }
+}
+
+static void fb_put(FormatBuffer& fb, const char* s, uint32_t n) {
+    fb.total += n;
+    while (n) {
+        if (fb.length == fb.capacity) {
+            if (!fb.sink) return;   // truncated; keep counting
+            fb_flush(fb);
+        }
+        uint32_t room = fb.capacity - fb.length;
+        uint32_t chunk = (n < room) ? n : room;
+        for (uint32_t i = 0; i < chunk; ++i) fb.data[fb.length + i] = s[i];
+        fb.length += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+static void fb_pad(FormatBuffer& fb, char c, int32_t count) {
+    char run[16];
+    for (uint32_t i = 0; i < sizeof(run); ++i) run[i] = c;
+    while (count > 0) {
+        uint32_t n = (count < (int32_t)sizeof(run)) ? (uint32_t)count : sizeof(run);
+        fb_put(fb, run, n);
+        count -= n;
+    }
+}
+
+// Emit 'body' (with optional sign/prefix) honouring width and flags
+static void fb_field(FormatBuffer& fb, const char* prefix, uint32_t prefix_len,
+                     const char* body, uint32_t body_len,
+                     int32_t width, bool left, bool zero) {
+    int32_t pad = width - (int32_t)(prefix_len + body_len);
+    if (!left && !zero) fb_pad(fb, ' ', pad);
+    fb_put(fb, prefix, prefix_len);
+    if (!left && zero) fb_pad(fb, '0', pad);
+    fb_put(fb, body, body_len);
+    if (left) fb_pad(fb, ' ', pad);
+}
+
+// Integers: a precision is the minimum digit count (zero-extended) and, as
+// in printf, turns the '0' flag off; a zero value with precision 0 is empty
+static void fb_integer(FormatBuffer& fb, const char* prefix, uint32_t prefix_len,
+                       const char* body, uint32_t body_len,
+                       int32_t width, int32_t precision, bool left, bool zero) {
+    if (precision < 0) {
+        fb_field(fb, prefix, prefix_len, body, body_len, width, left, zero);
+        return;
+    }
+    if (precision == 0 && body_len == 1 && body[0] == '0') body_len = 0;
+    int32_t zeros = precision - (int32_t)body_len;
+    if (zeros < 0) zeros = 0;
+    int32_t pad = width - (int32_t)(prefix_len + body_len) - zeros;
+    if (!left) fb_pad(fb, ' ', pad);
+    fb_put(fb, prefix, prefix_len);
+    fb_pad(fb, '0', zeros);
+    fb_put(fb, body, body_len);
+    if (left) fb_pad(fb, ' ', pad);
+}
+
+// ----------------------------------------------------------------------------
+// Formatting engine
+// ----------------------------------------------------------------------------
+static void format_into(FormatBuffer& fb, const char* fmt, va_list args) {
+    char digits[24];
+    char* const digits_end = digits + sizeof(digits);
+
+    while (*fmt) {
+        // Copy literal text up to the next conversion in one go
+        const char* lit = fmt;
+        while (*fmt && *fmt != '%') fmt++;
+        if (fmt != lit) fb_put(fb, lit, (uint32_t)(fmt - lit));
+        if (!*fmt) break;
+        fmt++;  // skip '%'
+
+        bool left = false, zero = false;
+        for (;; fmt++) {
+            if (*fmt == '-') left = true;
+            else if (*fmt == '0') zero = true;
+            else break;
+        }
+
+        int32_t width = 0;
+        if (*fmt == '*') {
+            width = va_arg(args, int);
+            if (width < 0) { left = true; width = -width; }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') width = width * 10 + (*fmt++ - '0');
+        }
+
+        int32_t precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            if (*fmt == '*') {
+                precision = va_arg(args, int);
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') precision = precision * 10 + (*fmt++ - '0');
+            }
+        }
+
+        uint32_t longs = 0;
+        while (*fmt == 'l') { longs++; fmt++; }
+        if (*fmt == 'z') fmt++;     // size_t is 32 bits here
+
+        char conv = *fmt ? *fmt++ : '\0';
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            int64_t v = (longs >= 2) ? va_arg(args, long long)
+                      : (longs == 1) ? (int64_t)va_arg(args, long)
+                      : (int64_t)va_arg(args, int);
+            uint64_t mag = (v < 0) ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+            uint32_t n = kformat_u64(digits_end, mag);
+            fb_integer(fb, "-", (v < 0) ? 1 : 0, digits_end - n, n, width, precision, left, zero);
+            break;
+        }
+        case 'u': {
+            uint64_t v = (longs >= 2) ? va_arg(args, unsigned long long)
+                       : (longs == 1) ? (uint64_t)va_arg(args, unsigned long)
+                       : (uint64_t)va_arg(args, unsigned int);
+            uint32_t n = kformat_u64(digits_end, v);
+            fb_integer(fb, "", 0, digits_end - n, n, width, precision, left, zero);
+            break;
+        }
+        case 'x':
+        case 'X': {
+            uint64_t v = (longs >= 2) ? va_arg(args, unsigned long long)
+                       : (longs == 1) ? (uint64_t)va_arg(args, unsigned long)
+                       : (uint64_t)va_arg(args, unsigned int);
+            uint32_t n = kformat_hex(digits_end, v, conv == 'X');
+            fb_integer(fb, "", 0, digits_end - n, n, width, precision, left, zero);
+            break;
+        }
+        case 'p': {
+            uint32_t v = (uint32_t)va_arg(args, void*);
+            char* p = digits_end;
+            for (int i = 0; i < 8; ++i, v >>= 4) *--p = HEX_LOWER[v & 0xF];
+            fb_field(fb, "0x", 2, p, 8, width, left, false);
+            break;
+        }
+        case 's': {
+            const char* s = va_arg(args, const char*);
+            if (!s) s = "(null)";
+            uint32_t n = 0;
+            while ((precision < 0 || n < (uint32_t)precision) && s[n]) n++;
+            fb_field(fb, "", 0, s, n, width, left, false);
+            break;
+        }
+        case 'c': {
+            char c = (char)va_arg(args, int);
+            fb_field(fb, "", 0, &c, 1, width, left, false);
+            break;
+        }
+        case '%':
+            fb_put(fb, "%", 1);
+            break;
+        default:
+            // Unknown conversion: print it verbatim so the mistake is visible
+            fb_put(fb, "%", 1);
+            if (conv) fb_put(fb, &conv, 1);
+            break;
+        }
+    }
+}
+
+int kvformat(KPrintSink sink, void* context, const char* fmt, va_list args) {
+    char staging[128];
+    FormatBuffer fb = { staging, sizeof(staging), 0, 0, sink, context };
+    format_into(fb, fmt, args);
+    fb_flush(fb);
+    return (int)fb.total;
+}
+
+int kvsnprintf(char* buffer, uint32_t size, const char* fmt, va_list args) {
+    FormatBuffer fb = { buffer, size ? size - 1 : 0, 0, 0, nullptr, nullptr };
+    format_into(fb, fmt, args);
+    if (size) buffer[fb.length] = '\0';
+    return (int)fb.total;
+}
+
+int ksnprintf(char* buffer, uint32_t size, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = kvsnprintf(buffer, size, fmt, args);
+    va_end(args);
+    return n;
+}
+
+// ----------------------------------------------------------------------------
+// Terminal and serial front ends
+// ----------------------------------------------------------------------------
+static void terminal_sink(void*, const char* data, uint32_t length) {
+    terminal.write(data, length);
+}
+
+static void serial_sink(void*, const char* data, uint32_t length) {
+    serial.write(data, length);
+}
+
+int kprintf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = kvformat(terminal_sink, nullptr, fmt, args);
+    va_end(args);
+    return n;
+}
+
+int kserial_printf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = kvformat(serial_sink, nullptr, fmt, args);
+    va_end(args);
+    return n;
+}
@@ -0,0 +1,42 @@
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+#include "types.h"
+#include <cstdarg>
+
+/*
+ * Formatted output for the kernel
+ * -------------------------------
+ * - printf-style formatting with no heap use: output is staged in a small
+ *   stack buffer and handed to the destination in bulk writes
+ * - Format strings are checked by the compiler (format attribute)
+ * - Supported conversions: %d %i %u %x %X %p %s %c %%
+ *   flags '-' and '0', field width and precision (also as '*'),
+ *   length modifiers 'l', 'll' and 'z'. Precision is the maximum length
+ *   for %s and the minimum digit count for integers (as in printf)
+ */
+
+// Destination callback for formatted output
+typedef void (*KPrintSink)(void* context, const char* data, uint32_t length);
+
+// Format into an arbitrary sink; returns the number of characters produced
+int kvformat(KPrintSink sink, void* context, const char* fmt, va_list args);
+
+// Format into a caller buffer; always NUL-terminates when size > 0 and
+// returns the length the full output would have had
+int kvsnprintf(char* buffer, uint32_t size, const char* fmt, va_list args);
+int ksnprintf(char* buffer, uint32_t size, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Format to the terminal
+int kprintf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Format to the serial console (COM1)
+int kserial_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Integer conversion helpers; write the digits ending at 'end' and return
+// the number of characters written (no terminator)
+uint32_t kformat_u64(char* end, uint64_t value);
+uint32_t kformat_hex(char* end, uint64_t value, bool upper);
+
+#endif // KPRINTF_H
@@ -0,0 +1,138 @@
+/*
+ * RusticOS statistics registry
+ * ----------------------------
+ * The registry is the .kstats section itself: an array of KStat assembled
+ * by the linker from every KSTAT_COUNTER()/KSTAT_GAUGE() definition.
+ */
+
+#include "kstats.h"
+#include "stream.h"
+#include "kprintf.h"
+#include "terminal.h"
+#include "keyboard.h"
+#include "vconsole.h"
+#include "clock.h"
+#include "thread.h"
+#include "io.h"
+
+extern Terminal terminal;
+
+// Provided by linker.ld around .kstats
+extern KStat __kstats_start[];
+extern KStat __kstats_end[];
+
+KSTAT_COUNTER(stat_snapshots, "kstats.snapshots");
+
+uint32_t kstats_count() {
+    return (uint32_t)(__kstats_end - __kstats_start);
+}
+
+uint32_t kstats_snapshot(uint32_t* values, uint32_t max) {
+    uint32_t count = kstats_count();
+    if (count > max) count = max;
+
+    uint32_t flags = irq_save();
+    kstat_inc(stat_snapshots);
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = __kstats_start[i].value;
+    }
+    irq_restore(flags);
+    return count;
+}
+
+void kstats_print(OutputStream& out) {
+    uint32_t values[KSTATS_MAX];
+    uint32_t count = kstats_snapshot(values, KSTATS_MAX);
+    for (uint32_t i = 0; i < count; ++i) {
+        const KStat& stat = __kstats_start[i];
+        kfprintf(out, "%-24s %10u%s\n", stat.name, values[i],
+                 stat.kind == KSTAT_KIND_GAUGE ? " (now)" : "");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// top
+// ---------------------------------------------------------------------------
+
+#define TOP_POLL_MS    20
+#define TOP_FIRST_ROW  2
+#define TOP_LINE_MAX   80
+
+// Write one screen row, padded so stale text from the last frame is erased.
+// Stops short of the last column so the terminal never wraps or scrolls.
+static void top_row(uint16_t row, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void top_row(uint16_t row, const char* fmt, ...) {
+    char line[TOP_LINE_MAX];
+    int width = terminal.getWidth() - 1;
+    if (width > TOP_LINE_MAX - 1) width = TOP_LINE_MAX - 1;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = kvsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n > width) n = width;
+    while (n < width) line[n++] = ' ';
+    line[n] = '\0';
+
+    terminal.setCursor(0, row);
+    terminal.write(line, (uint32_t)n);
+}
+
+static bool top_quit_requested() {
+    KeyEvent event;
+    while (keyboard.get_key_event(event)) {
+        if (vconsoles.handle_key(event)) {
+            continue;
+        }
+        if (event.pressed && (event.ascii == 'q' || event.scan_code == KEY_ESCAPE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void kstats_top(uint32_t interval_ms) {
+    static uint32_t previous[KSTATS_MAX];
+    static uint32_t current[KSTATS_MAX];
+
+    const uint16_t max_rows = terminal.getHeight() - TOP_FIRST_ROW;
+    uint32_t count = kstats_snapshot(previous, KSTATS_MAX);
+    uint64_t last_ns = now_ns();
+
+    terminal.clear();
+
+    bool quit = false;
+    while (!quit) {
+        uint64_t deadline = last_ns + (uint64_t)interval_ms * 1000000ULL;
+        while (now_ns() < deadline) {
+            if (top_quit_requested()) {
+                quit = true;
+                break;
+            }
+            thread_sleep_ms(TOP_POLL_MS);
+        }
+        if (quit) break;
+
+        count = kstats_snapshot(current, KSTATS_MAX);
+        uint64_t now = now_ns();
+        uint64_t elapsed_ns = now - last_ns;
+        last_ns = now;
+
+        top_row(0, "top: %u statistics, every %u ms, uptime %u s   (q to quit)",
+                count, interval_ms, (uint32_t)(now / 1000000000ULL));
+        top_row(1, "%-24s %12s %12s", "statistic", "value", "per second");
+        for (uint32_t i = 0; i < count && i < max_rows; ++i) {
+            const KStat& stat = __kstats_start[i];
+            if (stat.kind == KSTAT_KIND_GAUGE) {
+                top_row((uint16_t)(TOP_FIRST_ROW + i), "%-24s %12u %12s", stat.name, current[i], "-");
+            } else {
+                uint64_t delta = (uint32_t)(current[i] - previous[i]);
+                uint64_t rate = elapsed_ns ? delta * 1000000000ULL / elapsed_ns : 0;
+                top_row((uint16_t)(TOP_FIRST_ROW + i), "%-24s %12u %12llu", stat.name, current[i], rate);
+            }
+            previous[i] = current[i];
+        }
+    }
+
+    terminal.clear();
+}
@@ -0,0 +1,62 @@
+#ifndef KSTATS_H
+#define KSTATS_H
+
+#include "types.h"
+
+class OutputStream;
+
+/*
+ * Kernel statistics registry
+ * --------------------------
+ * - A statistic is a named 32-bit value defined at file scope with
+ *   KSTAT_COUNTER() or KSTAT_GAUGE(). The definition places it in the
+ *   .kstats section, and the linker script brackets that section with
+ *   __kstats_start/__kstats_end, so there is no registration call and no
+ *   list to keep in sync
+ * - Updating a statistic is a single add or store to a static address; the
+ *   registry is only walked when someone asks for a snapshot. The add is
+ *   not locked, so two CPUs bumping the same counter can lose a count;
+ *   that is the price of keeping it off the hot paths' critical sections
+ * - Counters only grow (and wrap; rates use the modular difference);
+ *   gauges hold a current level such as bytes in use
+ * - Names are "subsystem.what", e.g. "fs.lookups"
+ */
+
+enum KStatKind : uint32_t {
+    KSTAT_KIND_COUNTER = 0,
+    KSTAT_KIND_GAUGE = 1,
+};
+
+struct KStat {
+    const char* name;
+    uint32_t kind;
+    uint32_t value;
+};
+
+#define KSTAT_DEFINE(var, kind, stat_name) \
+    static KStat var __attribute__((section(".kstats"), used, aligned(4))) = { stat_name, kind, 0 }
+
+#define KSTAT_COUNTER(var, stat_name) KSTAT_DEFINE(var, KSTAT_KIND_COUNTER, stat_name)
+#define KSTAT_GAUGE(var, stat_name)   KSTAT_DEFINE(var, KSTAT_KIND_GAUGE, stat_name)
+
+static inline void kstat_inc(KStat& stat) { stat.value++; }
+static inline void kstat_add(KStat& stat, uint32_t n) { stat.value += n; }
+static inline void kstat_sub(KStat& stat, uint32_t n) { stat.value -= n; }
+static inline void kstat_set(KStat& stat, uint32_t v) { stat.value = v; }
+
+#define KSTATS_MAX 64
+
+uint32_t kstats_count();
+
+// Copy every value (in registry order) with interrupts off, so the
+// snapshot is consistent; returns the number of values written
+uint32_t kstats_snapshot(uint32_t* values, uint32_t max);
+
+// Print "name value" for every statistic
+void kstats_print(OutputStream& out);
+
+// Full-screen view on the shell terminal that redraws every interval_ms
+// with per-second rates for counters; returns on 'q' or Escape
+void kstats_top(uint32_t interval_ms);
+
+#endif // KSTATS_H
@@ -0,0 +1,130 @@
+/*
+ * RusticOS local APIC driver
+ * --------------------------
+ * Register access, EOI, startup IPIs and the per-CPU timer.
+ */
+
+#include "lapic.h"
+#include "interrupts.h"
+#include "clock.h"
+#include "cpu.h"
+#include "io.h"
+
+// Register offsets (bytes)
+#define LAPIC_ID            0x020
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+#define SVR_ENABLE          0x100
+#define LVT_MASKED          0x10000
+#define LVT_TIMER_PERIODIC  0x20000
+#define LVT_DELIVERY_EXTINT 0x700
+#define LVT_DELIVERY_NMI    0x400
+#define TIMER_DIVIDE_16     0x3
+
+#define ICR_DELIVERY_INIT    0x500
+#define ICR_DELIVERY_STARTUP 0x600
+#define ICR_LEVEL_ASSERT     0x4000
+#define ICR_SEND_PENDING     0x1000
+#define ICR_DEST_SHIFT       24
+
+#define ICR_TIMEOUT_US       1000
+#define CALIBRATE_US         10000
+
+static volatile uint32_t* regs = nullptr;
+static uint32_t timer_hz = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return regs[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    regs[reg / 4] = value;
+}
+
+void lapic_init(uint32_t base) {
+    regs = (volatile uint32_t*)base;
+}
+
+bool lapic_present() {
+    return regs != nullptr;
+}
+
+void lapic_enable(bool boot_cpu) {
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | VECTOR_SPURIOUS);
+    if (boot_cpu) {
+        lapic_write(LAPIC_LVT_LINT0, LVT_DELIVERY_EXTINT);
+        lapic_write(LAPIC_LVT_LINT1, LVT_DELIVERY_NMI);
+    } else {
+        lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);
+        lapic_write(LAPIC_LVT_LINT1, LVT_MASKED);
+    }
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+}
+
+uint8_t lapic_id() {
+    return (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+}
+
+void lapic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+static bool send_ipi(uint8_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << ICR_DEST_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, command);
+    for (uint32_t waited = 0; waited < ICR_TIMEOUT_US; waited += 10) {
+        if ((lapic_read(LAPIC_ICR_LOW) & ICR_SEND_PENDING) == 0) {
+            return true;
+        }
+        udelay(10);
+    }
+    return false;
+}
+
+bool lapic_send_init(uint8_t apic_id) {
+    return send_ipi(apic_id, ICR_DELIVERY_INIT | ICR_LEVEL_ASSERT);
+}
+
+bool lapic_send_startup(uint8_t apic_id, uint32_t start_address) {
+    // The vector field is the page number of the real-mode entry point
+    return send_ipi(apic_id, ICR_DELIVERY_STARTUP | ICR_LEVEL_ASSERT | ((start_address >> 12) & 0xFF));
+}
+
+void lapic_timer_calibrate() {
+    uint32_t flags = irq_save();
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    udelay(CALIBRATE_US);
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    irq_restore(flags);
+
+    timer_hz = (uint32_t)((uint64_t)elapsed * 1000000 / CALIBRATE_US);
+}
+
+void lapic_timer_start(uint32_t hz) {
+    if (timer_hz == 0 || hz == 0) {
+        return;
+    }
+    uint32_t count = timer_hz / hz;
+    if (count == 0) count = 1;
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_TIMER_PERIODIC | VECTOR_LAPIC_TIMER);
+    lapic_write(LAPIC_TIMER_INITIAL, count);
+}
+
+uint32_t lapic_timer_hz() {
+    return timer_hz;
+}
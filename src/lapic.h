@@ -0,0 +1,35 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include "types.h"
+
+/*
+ * Local APIC
+ * ----------
+ * - Memory-mapped registers at the address the MADT reports (normally
+ *   0xFEE00000); each CPU sees its own APIC at the same address
+ * - The boot CPU keeps taking legacy IRQs from the 8259 through LINT0
+ *   (virtual wire); application processors mask LINT0
+ * - The timer is calibrated once against the TSC/PIT delay and then runs
+ *   periodically on every CPU that calls lapic_timer_start()
+ * - The IPI helpers are only what AP startup needs: INIT and STARTUP
+ */
+
+void lapic_init(uint32_t base);
+bool lapic_present();
+
+// Software-enable this CPU's APIC; 'boot_cpu' keeps the 8259 routed in
+void lapic_enable(bool boot_cpu);
+
+uint8_t lapic_id();
+void lapic_eoi();
+
+// Returns false if the APIC never reported the IPI as delivered
+bool lapic_send_init(uint8_t apic_id);
+bool lapic_send_startup(uint8_t apic_id, uint32_t start_address);
+
+void lapic_timer_calibrate();
+void lapic_timer_start(uint32_t hz);
+uint32_t lapic_timer_hz();          // bus clock after the divider
+
+#endif // LAPIC_H
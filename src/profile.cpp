@@ -0,0 +1,172 @@
+/*
+ * RusticOS sampling profiler
+ * --------------------------
+ * The table is open-addressed on a hash of the whole stack, probed
+ * linearly for a bounded distance, and shared by all CPUs under one
+ * spinlock. Ticks run with interrupts disabled, so the lock is only ever
+ * contended by another CPU's tick or by a dump.
+ *
+ * The frame-pointer walk trusts nothing: every saved EBP must be aligned,
+ * above the previous one and inside kernel memory, and every return
+ * address inside the kernel image, or the walk stops there.
+ */
+
+#include "profile.h"
+#include "interrupts.h"
+#include "spinlock.h"
+#include "serial.h"
+#include "kprintf.h"
+#include "stream.h"
+#include "kstats.h"
+
+#define PROFILE_MAX_PROBES 32
+#define PROFILE_LINE_MAX   (96 + PROFILE_MAX_DEPTH * 9)
+
+struct ProfileEntry {
+    uint32_t count;
+    uint32_t depth;
+    uint32_t pcs[PROFILE_MAX_DEPTH];    // leaf first
+};
+
+// Defined in crt0.s / linker.ld
+extern "C" char _start[];
+extern "C" char __text_end[];
+extern "C" char __bss_end[];
+
+static ProfileEntry table[PROFILE_SLOTS];
+static Spinlock table_lock;
+static volatile bool running = false;
+static uint32_t samples = 0;
+static uint32_t dropped = 0;
+static uint32_t stacks = 0;
+
+KSTAT_COUNTER(stat_profile_samples, "profile.samples");
+
+static inline bool in_text(uint32_t pc) {
+    return pc >= (uint32_t)_start && pc < (uint32_t)__text_end;
+}
+
+static uint32_t capture(const InterruptFrame* frame, uint32_t* pcs) {
+    pcs[0] = frame->eip;
+    uint32_t depth = 1;
+#ifdef PROFILE_FP
+    uint32_t ebp = frame->ebp;
+    while (depth < PROFILE_MAX_DEPTH) {
+        if (ebp < 0x1000 || (ebp & 3) || ebp + 8 > (uint32_t)__bss_end) {
+            break;
+        }
+        const uint32_t* saved = (const uint32_t*)ebp;
+        uint32_t ret = saved[1];
+        if (!in_text(ret)) {
+            break;
+        }
+        pcs[depth++] = ret;
+        if (saved[0] <= ebp) {
+            break;
+        }
+        ebp = saved[0];
+    }
+#endif
+    return depth;
+}
+
+// FNV-1a over the return addresses
+static uint32_t stack_hash(const uint32_t* pcs, uint32_t depth) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < depth; ++i) {
+        hash = (hash ^ pcs[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool same_stack(const ProfileEntry& entry, const uint32_t* pcs, uint32_t depth) {
+    if (entry.depth != depth) return false;
+    for (uint32_t i = 0; i < depth; ++i) {
+        if (entry.pcs[i] != pcs[i]) return false;
+    }
+    return true;
+}
+
+void profile_tick(const InterruptFrame* frame) {
+    if (!running) {
+        return;
+    }
+    uint32_t pcs[PROFILE_MAX_DEPTH];
+    uint32_t depth = capture(frame, pcs);
+    uint32_t slot = stack_hash(pcs, depth) & (PROFILE_SLOTS - 1);
+
+    table_lock.lock();
+    samples++;
+    bool recorded = false;
+    for (uint32_t probe = 0; probe < PROFILE_MAX_PROBES; ++probe) {
+        ProfileEntry& entry = table[(slot + probe) & (PROFILE_SLOTS - 1)];
+        if (entry.count == 0) {
+            entry.depth = depth;
+            for (uint32_t i = 0; i < depth; ++i) entry.pcs[i] = pcs[i];
+            entry.count = 1;
+            stacks++;
+            recorded = true;
+            break;
+        }
+        if (same_stack(entry, pcs, depth)) {
+            entry.count++;
+            recorded = true;
+            break;
+        }
+    }
+    if (!recorded) dropped++;
+    table_lock.unlock();
+    kstat_inc(stat_profile_samples);
+}
+
+void profile_start() {
+    uint32_t flags = table_lock.lock_irqsave();
+    for (uint32_t i = 0; i < PROFILE_SLOTS; ++i) {
+        table[i].count = 0;
+    }
+    samples = dropped = stacks = 0;
+    running = true;
+    table_lock.unlock_irqrestore(flags);
+}
+
+void profile_stop() {
+    running = false;
+}
+
+bool profile_running() {
+    return running;
+}
+
+void profile_status(OutputStream& out) {
+    kfprintf(out, "profile: %s, %u samples in %u stacks, %u dropped, depth %u\n",
+             running ? "running" : "stopped", samples, stacks, dropped, PROFILE_MAX_DEPTH);
+}
+
+void profile_dump(OutputStream& out) {
+    // One serial write per line keeps klog output from landing mid-line
+    char line[PROFILE_LINE_MAX];
+    int n = ksnprintf(line, sizeof(line), "profile: begin samples=%u stacks=%u dropped=%u depth=%u\n",
+                      samples, stacks, dropped, PROFILE_MAX_DEPTH);
+    serial.write(line, (uint32_t)n);
+
+    for (uint32_t i = 0; i < PROFILE_SLOTS; ++i) {
+        // Copied under the lock so a running profile can be dumped
+        uint32_t flags = table_lock.lock_irqsave();
+        ProfileEntry entry = table[i];
+        table_lock.unlock_irqrestore(flags);
+        if (entry.count == 0) {
+            continue;
+        }
+
+        uint32_t len = (uint32_t)ksnprintf(line, sizeof(line), "%u", entry.count);
+        for (uint32_t d = 0; d < entry.depth; ++d) {
+            len += (uint32_t)ksnprintf(line + len, sizeof(line) - len, " %08x", entry.pcs[d]);
+        }
+        line[len++] = '\n';
+        serial.write(line, len);
+    }
+    serial.write("profile: end\n");
+
+    profile_status(out);
+    kfprintf(out, "profile: samples sent to COM1 (scripts/symbolize_profile.py)\n");
+}
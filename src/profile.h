@@ -0,0 +1,43 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+
+class OutputStream;
+struct InterruptFrame;
+
+/*
+ * Sampling profiler
+ * -----------------
+ * - While running, every scheduler tick on every CPU (IRQ0 on the boot
+ *   CPU, the APIC timer elsewhere, SCHED_TICK_HZ each) records the
+ *   interrupted EIP in a fixed-size hash table of distinct call stacks
+ * - With PROFILE_FP=1 the kernel is built with frame pointers and each
+ *   sample also walks up to PROFILE_MAX_DEPTH-1 callers from the
+ *   interrupted EBP; otherwise a stack is just the sampled EIP
+ * - Samples that find the table full are counted as dropped
+ * - profile_dump() writes the table to COM1 as text between "profile:
+ *   begin" and "profile: end" lines; scripts/symbolize_profile.py turns a
+ *   serial log into collapsed stacks for flamegraph.pl or speedscope
+ */
+
+#define PROFILE_SLOTS 1024
+
+#ifdef PROFILE_FP
+#define PROFILE_MAX_DEPTH 16
+#else
+#define PROFILE_MAX_DEPTH 1
+#endif
+
+void profile_start();           // clears previous samples
+void profile_stop();
+bool profile_running();
+
+// Called from interrupt_dispatch for the tick vectors
+void profile_tick(const InterruptFrame* frame);
+
+// Sends the samples to COM1 and a one-line summary to 'out'
+void profile_dump(OutputStream& out);
+void profile_status(OutputStream& out);
+
+#endif // PROFILE_H
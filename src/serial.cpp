@@ -0,0 +1,118 @@
+/*
+ * RusticOS 16550 UART driver
+ * --------------------------
+ * Queues output in a TX ring and feeds the transmit FIFO from either the
+ * THR-empty interrupt (IRQ4) or poll(). The SpscRing allows one producer
+ * and one consumer at a time: writers on any CPU (or in an IRQ handler)
+ * serialize on tx_lock, and drain_fifo() callers on drain_lock, with
+ * interrupts disabled so an IRQ never spins on a lock its CPU holds.
+ */
+
+#include "serial.h"
+#include "io.h"
+#include "kstats.h"
+
+// UART register offsets from the base port
+#define UART_DATA   0   // THR (write) / RBR (read); divisor low with DLAB
+#define UART_IER    1   // Interrupt enable; divisor high with DLAB
+#define UART_IIR    2   // Interrupt identification (read)
+#define UART_FCR    2   // FIFO control (write)
+#define UART_LCR    3   // Line control
+#define UART_MCR    4   // Modem control
+#define UART_LSR    5   // Line status
+
+#define UART_BAUD_DIV   0x03    // 115200 / 3 = 38400 baud
+#define UART_LCR_8N1    0x03
+#define UART_LCR_DLAB   0x80
+#define UART_FCR_ENABLE 0xC7    // Enable + clear both FIFOs, 14-byte RX trigger
+#define UART_MCR_OUT2   0x0B    // DTR | RTS | OUT2 (OUT2 gates the IRQ line)
+#define UART_IER_THRE   0x02
+#define UART_LSR_THRE   0x20    // Transmit holding register (FIFO) empty
+#define UART_LSR_TEMT   0x40    // Transmitter completely idle
+
+SerialPort serial;
+
+KSTAT_COUNTER(stat_tx_bytes, "serial.tx_bytes");
+
+void SerialPort::init(uint16_t port) {
+    base = port;
+    tx_ring.reset();
+    irq_driven = false;
+
+    outb(base + UART_IER, 0x00);                // Disable all interrupts
+    outb(base + UART_LCR, UART_LCR_DLAB);       // Enable DLAB (set baud rate divisor)
+    outb(base + UART_DATA, UART_BAUD_DIV);      // Divisor low byte
+    outb(base + UART_IER, 0x00);                // Divisor high byte
+    outb(base + UART_LCR, UART_LCR_8N1);        // 8 bits, no parity, 1 stop
+    outb(base + UART_FCR, UART_FCR_ENABLE);     // Enable and clear FIFOs
+    outb(base + UART_MCR, UART_MCR_OUT2);
+}
+
+void SerialPort::enable_tx_interrupt() {
+    irq_driven = true;
+    outb(base + UART_IER, UART_IER_THRE);
+}
+
+bool SerialPort::transmitter_empty() const {
+    return (inb(base + UART_LSR) & UART_LSR_TEMT) != 0;
+}
+
+void SerialPort::drain_fifo() {
+    // Only touch THR when the FIFO is empty; then it accepts a full burst
+    if ((inb(base + UART_LSR) & UART_LSR_THRE) == 0) {
+        return;
+    }
+
+    char burst[TX_FIFO_DEPTH];
+    uint32_t count = tx_ring.pop_batch(burst, TX_FIFO_DEPTH);
+    for (uint32_t i = 0; i < count; ++i) {
+        outb(base + UART_DATA, (uint8_t)burst[i]);
+    }
+}
+
+void SerialPort::write(const char* data, uint32_t length) {
+    kstat_add(stat_tx_bytes, length);
+    uint32_t flags = tx_lock.lock_irqsave();
+    while (length > 0) {
+        uint32_t space = tx_ring.free_space();
+        if (space == 0) {
+            // Ring full: wait on the line-status register and push bytes
+            // out from this context rather than dropping output
+            poll();
+            continue;
+        }
+
+        uint32_t chunk = tx_ring.push_batch(data, (length < space) ? length : space);
+        data += chunk;
+        length -= chunk;
+    }
+    tx_lock.unlock_irqrestore(flags);
+
+    // Start the transmitter if it went idle; the THR-empty IRQ takes over
+    poll();
+}
+
+void SerialPort::write(const char* str) {
+    uint32_t length = 0;
+    while (str[length]) length++;
+    write(str, length);
+}
+
+void SerialPort::poll() {
+    uint32_t flags = drain_lock.lock_irqsave();
+    drain_fifo();
+    drain_lock.unlock_irqrestore(flags);
+}
+
+void SerialPort::flush() {
+    while (pending() != 0 || !transmitter_empty()) {
+        poll();
+    }
+}
+
+void SerialPort::handle_interrupt() {
+    inb(base + UART_IIR);   // Acknowledge the THR-empty condition
+    drain_lock.lock();
+    drain_fifo();
+    drain_lock.unlock();
+}
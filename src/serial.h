@@ -0,0 +1,52 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "types.h"
+#include "spsc_ring.h"
+#include "spinlock.h"
+
+/*
+ * 16550 UART driver (COM1)
+ * ------------------------
+ * - Output is queued in a single-producer/single-consumer SpscRing and moved
+ *   into the 16-byte transmit FIFO whenever the line-status register reports
+ *   the holding register empty
+ * - Once IRQ4 is routed, the THR-empty interrupt drains the ring; before that
+ *   (early boot) writers prime the FIFO themselves through poll()
+ * - Callers never spin on fixed delays; they only wait on the status register
+ *   when the ring itself is full
+ */
+
+#define COM1_PORT 0x3F8
+
+class SerialPort {
+private:
+    static const uint32_t TX_BUFFER_SIZE = 4096;   // must be a power of two
+    static const uint32_t TX_FIFO_DEPTH = 16;      // 16550A transmit FIFO
+
+    SpscRing<char, TX_BUFFER_SIZE> tx_ring;
+    Spinlock tx_lock;                // one producer at a time
+    Spinlock drain_lock;             // one consumer at a time
+    uint16_t base;
+    bool irq_driven;
+
+    void drain_fifo();               // move ring -> FIFO while THR is empty
+    bool transmitter_empty() const;
+
+public:
+    void init(uint16_t port = COM1_PORT);
+    void enable_tx_interrupt();
+
+    void write(const char* data, uint32_t length);
+    void write(const char* str);
+
+    void poll();                     // service the transmitter without IRQs
+    void flush();                    // wait until every queued byte is sent
+    void handle_interrupt();         // IRQ4 entry point
+
+    uint32_t pending() const { return tx_ring.size(); }
+};
+
+extern SerialPort serial;
+
+#endif // SERIAL_H
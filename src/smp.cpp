@@ -0,0 +1,210 @@
+/*
+ * RusticOS SMP bring-up
+ * ---------------------
+ * The kernel GDT replaces the loader's (same code and data selectors) and
+ * adds the per-CPU %gs segments; every CPU loads it before anything else.
+ *
+ * The boot CPU copies the trampoline below 1 MiB, patches in a stack (the
+ * AP's idle thread stack) and the C entry point, and sends INIT, then up
+ * to two STARTUP IPIs, with the delays the MP specification asks for. The
+ * AP copies the boot CPU's CR0/CR4 (SSE enable), loads the shared IDT,
+ * enables its local APIC and becomes its idle thread.
+ */
+
+#include "smp.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "interrupts.h"
+#include "thread.h"
+#include "clock.h"
+#include "cpu.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "stream.h"
+#include <cstring>
+
+#define AP_TRAMPOLINE_BASE  0x8000  // must match trampoline.s
+#define AP_INIT_DELAY_MS    10
+#define AP_SIPI_DELAY_US    200
+#define AP_START_TIMEOUT_MS 100
+
+#define GDT_KERNEL_CODE     1       // selector 0x08
+#define GDT_KERNEL_DATA     2       // selector 0x10
+#define GDT_CPU_LOCAL       3       // first per-CPU %gs segment
+#define GDT_ENTRIES         (GDT_CPU_LOCAL + MAX_CPUS)
+
+#define SEG_ACCESS_CODE     0x9A    // present, ring 0, execute/read
+#define SEG_ACCESS_DATA     0x92    // present, ring 0, read/write
+#define SEG_FLAGS_FLAT      0xC     // 4 KiB granularity, 32-bit
+#define SEG_FLAGS_BYTES     0x4     // byte granularity, 32-bit
+
+struct GdtPointer {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed));
+
+extern "C" uint8_t ap_trampoline_start[];
+extern "C" uint8_t ap_trampoline_end[];
+extern "C" uint8_t ap_trampoline_stack[];
+extern "C" uint8_t ap_trampoline_entry[];
+extern "C" uint8_t ap_trampoline_cpu[];
+
+static uint64_t gdt[GDT_ENTRIES] __attribute__((aligned(8)));
+static CpuLocal cpu_locals[MAX_CPUS];
+
+static uint32_t cpu_count = 1;
+static uint8_t apic_ids[MAX_CPUS];
+static uint32_t boot_cr0 = 0;
+static uint32_t boot_cr4 = 0;
+
+static uint64_t segment_descriptor(uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    return (uint64_t)(limit & 0xFFFF) |
+           ((uint64_t)(base & 0xFFFFFF) << 16) |
+           ((uint64_t)access << 40) |
+           ((uint64_t)((limit >> 16) & 0xF) << 48) |
+           ((uint64_t)flags << 52) |
+           ((uint64_t)(base >> 24) << 56);
+}
+
+// Switch this CPU to the kernel GDT and point %gs at its CpuLocal block
+static void load_cpu_segments(uint32_t cpu) {
+    GdtPointer ptr = { sizeof(gdt) - 1, (uint32_t)gdt };
+    uint16_t local_selector = (uint16_t)((GDT_CPU_LOCAL + cpu) * 8);
+    __asm__ __volatile__(
+        "lgdt %0\n\t"
+        "ljmp $0x08, $1f\n"
+        "1:\n\t"
+        "movw $0x10, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movw %%ax, %%es\n\t"
+        "movw %%ax, %%fs\n\t"
+        "movw %%ax, %%ss\n\t"
+        "movw %1, %%gs"
+        : : "m"(ptr), "r"(local_selector) : "eax", "memory");
+}
+
+void smp_boot_cpu_init() {
+    gdt[0] = 0;
+    gdt[GDT_KERNEL_CODE] = segment_descriptor(0, 0xFFFFF, SEG_ACCESS_CODE, SEG_FLAGS_FLAT);
+    gdt[GDT_KERNEL_DATA] = segment_descriptor(0, 0xFFFFF, SEG_ACCESS_DATA, SEG_FLAGS_FLAT);
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu) {
+        cpu_locals[cpu].index = cpu;
+        gdt[GDT_CPU_LOCAL + cpu] = segment_descriptor((uint32_t)&cpu_locals[cpu], sizeof(CpuLocal) - 1,
+                                                      SEG_ACCESS_DATA, SEG_FLAGS_BYTES);
+    }
+    load_cpu_segments(0);
+}
+
+uint32_t smp_cpu_count() {
+    return cpu_count;
+}
+
+uint8_t smp_apic_id(uint32_t cpu) {
+    return (cpu < cpu_count) ? apic_ids[cpu] : 0;
+}
+
+static void lapic_timer_irq(InterruptFrame*) {
+    sched_timer_tick();
+}
+
+extern "C" void ap_main(uint32_t cpu) {
+    load_cpu_segments(cpu);
+    write_cr0(boot_cr0);
+    write_cr4(boot_cr4);
+    __asm__ __volatile__("fninit");
+    interrupts_load_idt();
+    lapic_enable(false);
+    lapic_timer_start(SCHED_TICK_HZ);
+
+    // Does not return: this stack now belongs to the CPU's idle thread
+    sched_ap_enter(cpu);
+}
+
+static void trampoline_set(uint8_t* base, uint8_t* field, uint32_t value) {
+    *(volatile uint32_t*)(base + (field - ap_trampoline_start)) = value;
+}
+
+static bool start_ap(uint32_t cpu) {
+    uint32_t stack_top = sched_prepare_cpu(cpu);
+    if (stack_top == 0) {
+        klog.log(LOG_WARN, "smp: no thread slot for an idle thread");
+        return false;
+    }
+
+    uint8_t* base = (uint8_t*)AP_TRAMPOLINE_BASE;
+    memcpy(base, ap_trampoline_start, (uint32_t)(ap_trampoline_end - ap_trampoline_start));
+    trampoline_set(base, ap_trampoline_stack, stack_top);
+    trampoline_set(base, ap_trampoline_entry, (uint32_t)ap_main);
+    trampoline_set(base, ap_trampoline_cpu, cpu);
+
+    uint8_t apic_id = apic_ids[cpu];
+    if (!lapic_send_init(apic_id)) {
+        return false;
+    }
+    mdelay(AP_INIT_DELAY_MS);
+
+    // The second SIPI is only needed if the first one was lost
+    for (uint32_t attempt = 0; attempt < 2; ++attempt) {
+        if (!lapic_send_startup(apic_id, AP_TRAMPOLINE_BASE)) {
+            return false;
+        }
+        udelay(AP_SIPI_DELAY_US);
+        if (sched_cpu_online(cpu)) {
+            return true;
+        }
+    }
+    for (uint32_t waited = 0; waited < AP_START_TIMEOUT_MS; ++waited) {
+        if (sched_cpu_online(cpu)) {
+            return true;
+        }
+        mdelay(1);
+    }
+    return false;
+}
+
+void smp_init() {
+    MadtInfo madt;
+    if (!acpi_read_madt(madt)) {
+        klog.log(LOG_INFO, "smp: no MADT, running on the boot CPU only");
+        return;
+    }
+
+    lapic_init(madt.lapic_address);
+    lapic_enable(true);
+    apic_ids[0] = lapic_id();
+
+    lapic_timer_calibrate();
+    local_vector_register(VECTOR_LAPIC_TIMER, lapic_timer_irq);
+    boot_cr0 = read_cr0();
+    boot_cr4 = read_cr4();
+
+    for (uint32_t i = 0; i < madt.cpu_count && cpu_count < MAX_CPUS; ++i) {
+        uint8_t apic_id = madt.apic_ids[i];
+        if (apic_id == apic_ids[0]) {
+            continue;
+        }
+        // A CPU that does not come up leaves its index to the next one
+        uint32_t cpu = cpu_count;
+        apic_ids[cpu] = apic_id;
+        if (start_ap(cpu)) {
+            cpu_count++;
+        } else {
+            klog.logf(LOG_WARN, "smp: APIC %u did not start", apic_id);
+        }
+    }
+
+    klog.logf(LOG_INFO, "smp: %u CPU(s) online, APIC timer %u kHz",
+              cpu_count, lapic_timer_hz() / 1000);
+}
+
+void smp_print(OutputStream& out) {
+    kfprintf(out, "%3s %4s %-5s %10s %10s %8s %s\n",
+             "CPU", "APIC", "TICK", "TICKS", "SWITCHES", "STEALS", "RUNNING");
+    for (uint32_t cpu = 0; cpu < cpu_count; ++cpu) {
+        SchedCpuStats stats;
+        sched_cpu_stats(cpu, stats);
+        kfprintf(out, "%3u %4u %-5s %10u %10u %8u %s\n", cpu, apic_ids[cpu],
+                 cpu == 0 ? "pit" : "apic", stats.ticks, stats.switches,
+                 stats.steals, stats.running);
+    }
+}
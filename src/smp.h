@@ -0,0 +1,50 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+
+class OutputStream;
+
+/*
+ * Multiprocessor bring-up
+ * -----------------------
+ * - smp_init() reads the ACPI MADT, enables the boot CPU's local APIC and
+ *   starts every other listed CPU with INIT-SIPI-SIPI through the real-mode
+ *   trampoline (trampoline.s), one at a time
+ * - CPUs are numbered 0..smp_cpu_count()-1 in the order they came online;
+ *   CPU 0 is the boot CPU
+ * - Every CPU loads the kernel GDT, which has one extra data segment per
+ *   CPU whose base is that CPU's CpuLocal block, and keeps its selector in
+ *   %gs. cpu_index() is then a single %gs-relative load instead of an APIC
+ *   register read (a VM exit under most hypervisors). Nothing switches
+ *   %gs, so it always names the CPU the code is running on
+ * - Legacy IRQs (PIT, keyboard, COM1) still arrive through the 8259 on the
+ *   boot CPU only; the other CPUs take nothing but their own APIC timer
+ */
+
+#define MAX_CPUS 8
+
+// Addressed through %gs; 'index' must stay first (see cpu_index())
+struct CpuLocal {
+    uint32_t index;
+};
+
+// Load the GDT and %gs on the boot CPU. Must run before anything calls
+// cpu_index(), i.e. first thing in kernel_main.
+void smp_boot_cpu_init();
+void smp_init();
+
+// Volatile: a thread preempted between two calls may resume on another CPU
+static inline uint32_t cpu_index() {
+    uint32_t index;
+    __asm__ __volatile__("movl %%gs:0, %0" : "=r"(index));
+    return index;
+}
+
+uint32_t smp_cpu_count();
+uint8_t smp_apic_id(uint32_t cpu);
+
+// One line per CPU: APIC ID, tick source and scheduler counters
+void smp_print(OutputStream& out);
+
+#endif // SMP_H
@@ -0,0 +1,53 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "cpu.h"
+#include "io.h"
+
+/*
+ * Test-and-test-and-set spinlock
+ * ------------------------------
+ * - lock() spins on a plain load (no bus locking while the lock is held
+ *   elsewhere) and only retries the atomic exchange once it looks free
+ * - Code that also runs in interrupt context must use lock_irqsave() on
+ *   the thread side, or an IRQ on the same CPU would spin forever
+ * - Not recursive; a CPU must never take the same lock twice
+ */
+
+class Spinlock {
+private:
+    volatile uint32_t locked;
+
+public:
+    constexpr Spinlock() : locked(0) {}
+
+    void lock() {
+        while (__atomic_exchange_n(&locked, 1, __ATOMIC_ACQUIRE)) {
+            while (__atomic_load_n(&locked, __ATOMIC_RELAXED)) {
+                cpu_relax();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return __atomic_exchange_n(&locked, 1, __ATOMIC_ACQUIRE) == 0;
+    }
+
+    void unlock() {
+        __atomic_store_n(&locked, 0, __ATOMIC_RELEASE);
+    }
+
+    uint32_t lock_irqsave() {
+        uint32_t flags = irq_save();
+        lock();
+        return flags;
+    }
+
+    void unlock_irqrestore(uint32_t flags) {
+        unlock();
+        irq_restore(flags);
+    }
+};
+
+#endif // SPINLOCK_H
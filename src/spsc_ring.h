@@ -0,0 +1,115 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "types.h"
+
+/*
+ * Lock-free single-producer/single-consumer ring
+ * ----------------------------------------------
+ * - Meant for IRQ-to-main-context handoff: exactly one side calls the push
+ *   functions and exactly one side calls the pop functions
+ * - head and tail are free-running 32-bit counters; the slot index is the
+ *   counter masked by N - 1, so N must be a power of two and no `%` is
+ *   needed. size() is head - tail, which stays correct across wrap-around
+ * - Each side publishes its counter with a release store after touching the
+ *   slots and reads the other side's counter with an acquire load. On x86
+ *   these are plain moves plus a compiler barrier
+ * - A full ring rejects new items (the newest is dropped) and counts them in
+ *   overflow_count() instead of overwriting data the consumer may be reading
+ */
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+private:
+    static const uint32_t MASK = N - 1;
+
+    T slots[N];
+    uint32_t head;          // next slot to fill, written by the producer
+    uint32_t tail;          // next slot to read, written by the consumer
+    uint32_t overflows;     // items rejected because the ring was full
+
+public:
+    SpscRing() : head(0), tail(0), overflows(0) {}
+
+    // Only safe while neither side is active (e.g. with the IRQ masked)
+    void reset() {
+        head = 0;
+        tail = 0;
+        overflows = 0;
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+
+    uint32_t size() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+    bool empty() const { return size() == 0; }
+    uint32_t overflow_count() const { return __atomic_load_n(&overflows, __ATOMIC_RELAXED); }
+
+    // ---- Producer side ----
+
+    bool push(const T& item) {
+        uint32_t h = head;
+        if (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) == N) {
+            __atomic_store_n(&overflows, overflows + 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        slots[h & MASK] = item;
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * Push up to `count` items with a single publish
+     * @return Number of items queued; the rest are counted as overflow
+     */
+    uint32_t push_batch(const T* items, uint32_t count) {
+        uint32_t h = head;
+        uint32_t space = N - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+        uint32_t n = count < space ? count : space;
+        for (uint32_t i = 0; i < n; ++i) {
+            slots[(h + i) & MASK] = items[i];
+        }
+        __atomic_store_n(&head, h + n, __ATOMIC_RELEASE);
+        if (n < count) {
+            __atomic_store_n(&overflows, overflows + (count - n), __ATOMIC_RELAXED);
+        }
+        return n;
+    }
+
+    // Free slots as seen by the producer
+    uint32_t free_space() const {
+        return N - (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+    }
+
+    // ---- Consumer side ----
+
+    bool pop(T& item) {
+        uint32_t t = tail;
+        if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == t) {
+            return false;
+        }
+        item = slots[t & MASK];
+        __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /**
+     * Pop up to `max` items with a single publish
+     * @return Number of items copied to `out`
+     */
+    uint32_t pop_batch(T* out, uint32_t max) {
+        uint32_t t = tail;
+        uint32_t available = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+        uint32_t n = max < available ? max : available;
+        for (uint32_t i = 0; i < n; ++i) {
+            out[i] = slots[(t + i) & MASK];
+        }
+        __atomic_store_n(&tail, t + n, __ATOMIC_RELEASE);
+        return n;
+    }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,92 @@
+/*
+ * RusticOS output streams
+ * -----------------------
+ * Console, file and pipe sinks for shell command output.
+ */
+
+#include "stream.h"
+#include "terminal.h"
+#include "filesystem.h"
+#include "kprintf.h"
+#include <cstring>
+
+void OutputStream::write(const char* str) {
+    write(str, strlen(str));
+}
+
+// ---------------------------------------------------------------------------
+// TerminalStream
+// ---------------------------------------------------------------------------
+
+void TerminalStream::put(const char* data, uint32_t length) {
+    target->write(data, length);
+}
+
+// ---------------------------------------------------------------------------
+// FileStream
+// ---------------------------------------------------------------------------
+
+bool FileStream::open(const char* file_name, bool append) {
+    name = nullptr;
+    if (!filesystem.find_file(file_name)) {
+        if (!filesystem.create_file(file_name, "")) {
+            return false;
+        }
+    } else if (!append) {
+        filesystem.write_file(file_name, "", 0);
+    }
+    name = file_name;
+    return true;
+}
+
+void FileStream::put(const char* data, uint32_t length) {
+    if (name) {
+        filesystem.append_file(name, data, length);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// PipeStream
+// ---------------------------------------------------------------------------
+
+void PipeStream::drain() {
+    if (used > 0) {
+        consumer->write(buffer, used);
+        used = 0;
+    }
+}
+
+void PipeStream::put(const char* data, uint32_t length) {
+    while (length > 0) {
+        uint32_t space = PIPE_BUFFER_SIZE - used;
+        uint32_t chunk = (length < space) ? length : space;
+        memcpy(buffer + used, data, chunk);
+        used += chunk;
+        data += chunk;
+        length -= chunk;
+        if (used == PIPE_BUFFER_SIZE) {
+            drain();
+        }
+    }
+}
+
+void PipeStream::close() {
+    drain();
+    consumer->close();
+}
+
+// ---------------------------------------------------------------------------
+// kfprintf
+// ---------------------------------------------------------------------------
+
+static void stream_sink(void* context, const char* data, uint32_t length) {
+    static_cast<OutputStream*>(context)->write(data, length);
+}
+
+int kfprintf(OutputStream& out, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = kvformat(stream_sink, &out, fmt, args);
+    va_end(args);
+    return n;
+}
@@ -0,0 +1,98 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "types.h"
+
+class Terminal;
+
+/*
+ * Output streams
+ * --------------
+ * - Commands write their output to an OutputStream instead of straight to
+ *   the terminal, so the shell can route it to the console, into a file
+ *   (> / >>) or into the next command of a pipeline
+ * - write() may be called any number of times; close() marks the end of
+ *   the stream exactly once and is passed along to downstream stages
+ * - No stream ever holds more than its own fixed buffer: data is handed on
+ *   as it is produced rather than collected
+ */
+
+class OutputStream {
+protected:
+    virtual void put(const char* data, uint32_t length) = 0;
+
+public:
+    void write(const char* data, uint32_t length) {
+        if (length > 0) put(data, length);
+    }
+    void write(const char* str);
+
+    virtual void close() {}
+};
+
+// Writes to a terminal (the shell console by default)
+class TerminalStream : public OutputStream {
+private:
+    Terminal* target;
+
+protected:
+    void put(const char* data, uint32_t length) override;
+
+public:
+    explicit TerminalStream(Terminal& terminal) : target(&terminal) {}
+};
+
+// Forwards to a stream owned by someone else and leaves closing it to its
+// owner (nested command lines share their caller's output this way)
+class SharedStream : public OutputStream {
+private:
+    OutputStream* target;
+
+protected:
+    void put(const char* data, uint32_t length) override { target->write(data, length); }
+
+public:
+    explicit SharedStream(OutputStream& stream) : target(&stream) {}
+};
+
+// Appends to a file in the current directory as data arrives
+class FileStream : public OutputStream {
+private:
+    const char* name;
+
+protected:
+    void put(const char* data, uint32_t length) override;
+
+public:
+    FileStream() : name(nullptr) {}
+
+    // Create the file if needed; truncate it unless appending
+    bool open(const char* file_name, bool append);
+};
+
+// Bounded buffer between two pipeline stages: batches the producer's
+// writes and hands them to the consumer whenever the buffer fills
+class PipeStream : public OutputStream {
+private:
+    static const uint32_t PIPE_BUFFER_SIZE = 512;
+
+    char buffer[PIPE_BUFFER_SIZE];
+    uint32_t used;
+    OutputStream* consumer;
+
+    void drain();
+
+protected:
+    void put(const char* data, uint32_t length) override;
+
+public:
+    PipeStream() : used(0), consumer(nullptr) {}
+
+    void connect(OutputStream* next) { consumer = next; used = 0; }
+    void close() override;
+};
+
+// Formatted output to a stream (see kprintf.h for the conversions)
+int kfprintf(OutputStream& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // STREAM_H
@@ -0,0 +1,45 @@
+# ============================================================================
+# RusticOS - Kernel thread context switch
+# ----------------------------------------------------------------------------
+# void thread_switch(uint32_t* save_esp, uint32_t load_esp,
+#                    volatile uint32_t* prev_on_cpu)
+#
+# Only the cdecl callee-saved registers (ebp, ebx, esi, edi) are kept: the
+# switch is an ordinary function call, so the compiler has already spilled
+# everything else. They are pushed on the old stack, esp is stored through
+# save_esp, and the new stack is popped in the same order. The final ret
+# resumes the new thread where it called thread_switch (or, for a thread
+# that never ran, at the entry address thread_create placed there).
+#
+# *prev_on_cpu is cleared only once the new stack is live: until then
+# another CPU that picked the old thread from a run queue must not load
+# its stack.
+#
+# EFLAGS is not switched; the scheduler calls this with interrupts disabled
+# and each thread restores its own saved flags after it returns.
+# ============================================================================
+
+.global thread_switch
+
+.section .text
+.code32
+
+.align 16
+thread_switch:
+    movl 4(%esp), %eax          # eax = save_esp
+    movl 8(%esp), %edx          # edx = load_esp
+    movl 12(%esp), %ecx         # ecx = prev_on_cpu
+
+    pushl %ebp
+    pushl %ebx
+    pushl %esi
+    pushl %edi
+    movl %esp, (%eax)
+
+    movl %edx, %esp
+    movl $0, (%ecx)             # old stack no longer in use
+    popl %edi
+    popl %esi
+    popl %ebx
+    popl %ebp
+    ret
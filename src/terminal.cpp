@@ -3,10 +3,18 @@
  * ---------------------------------
  * Provides a simple console abstraction on top of VGA text mode. Includes
  * cursor management, scrolling, and basic line input helpers.
+ *
+ * All drawing goes through 'screen', which points at the VGA text buffer
+ * while the terminal is displayed and at its own back buffer otherwise, so
+ * background terminals never touch 0xB8000.
  */
 
 #include "terminal.h"
+#include "fbconsole.h"
+#include "kstats.h"
+#include "trace.h"
 #include <cstddef>
+#include <cstring>
 
 // ----------------------------------------------------------------------------
 // Port I/O helpers
@@ -33,6 +41,16 @@ static inline void* my_memcpy(void* destination, const void* source, uint32_t nu
     return destination;
 }
 
+KSTAT_COUNTER(stat_cells_written, "term.cells_written");
+KSTAT_COUNTER(stat_cells_copied, "term.cells_copied");
+
+static inline void copy_cells(volatile uint16_t* dst, const volatile uint16_t* src, uint32_t count) {
+    kstat_add(stat_cells_copied, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Global terminal instance and VGA buffer mapping
 // ----------------------------------------------------------------------------
@@ -41,7 +59,9 @@ volatile uint16_t* const Terminal::VGA_BUFFER = (volatile uint16_t*)0xB8000;
 
 Terminal::Terminal()
     : cursor_x(0), cursor_y(0), foreground_color(LIGHT_GREY), background_color(BLACK),
-      cursor_visible(true), scroll_offset(0), input_pos(0), input_mode(false) {
+      cursor_visible(true), screen(cells), displayed(false), viewing_history(false),
+      scrollback_count(0), scroll_offset(0), input_pos(0), input_mode(false),
+      mirror(nullptr) {
     clear();
 }
 
@@ -51,66 +71,69 @@ void Terminal::clear() {
     // Correct encoding: (BG << 4 | FG) << 8
     for (uint32_t i = 0; i < VGA_WIDTH * VGA_HEIGHT; ++i) {
         uint16_t attr = ((uint16_t)(background_color << 4) | (uint16_t)foreground_color) << 8;
-        VGA_BUFFER[i] = (uint16_t)' ' | attr;
+        screen[i] = (uint16_t)' ' | attr;
     }
     cursor_x = cursor_y = 0;
     update_cursor();
+
+    if (mirror && !viewing_history) mirror->clear();
 }
 
 void Terminal::setColor(uint8_t fg, uint8_t bg) {
     foreground_color = fg;
     background_color = bg;
+    if (mirror) mirror->setColor(fg, bg);
 }
 
-void Terminal::putChar(char c) {
-    // Handle control characters
-    if (c == '\n') {
-        cursor_x = 0;
-        cursor_y++;
-        if (cursor_y >= VGA_HEIGHT) {
-            scrollUp(1);
-            cursor_y = VGA_HEIGHT - 1;
-        }
-        update_cursor();
-        return;
+void Terminal::new_line() {
+    cursor_x = 0;
+    cursor_y++;
+    if (cursor_y >= VGA_HEIGHT) {
+        scroll_up(1);
+        cursor_y = VGA_HEIGHT - 1;
     }
+}
 
-    if (c == '\r') {
+void Terminal::put_control(char c) {
+    switch (c) {
+    case '\n':
+        new_line();
+        break;
+    case '\r':
         cursor_x = 0;
-        update_cursor();
-        return;
-    }
-
-    if (c == '\t') {
+        break;
+    case '\t':
         cursor_x = (cursor_x + 8) & ~7; // Align to 8-character boundary
         if (cursor_x >= VGA_WIDTH) {
-            cursor_x = 0;
-            cursor_y++;
-            if (cursor_y >= VGA_HEIGHT) {
-                scrollUp(1);
-                cursor_y = VGA_HEIGHT - 1;
-            }
+            new_line();
+        }
+        break;
+    case '\b':
+        if (cursor_x > 0) {
+            cursor_x--;
         }
+        break;
+    default:
+        break;
+    }
+}
+
+void Terminal::putChar(char c) {
+    if (mirror && !viewing_history) mirror->write(&c, 1);
+
+    if (is_control(c)) {
+        put_control(c);
         update_cursor();
         return;
     }
 
     // Advance to next line if end of row reached
     if (cursor_x >= VGA_WIDTH) {
-        cursor_x = 0;
-        cursor_y++;
-        if (cursor_y >= VGA_HEIGHT) {
-            scrollUp(1);
-            cursor_y = VGA_HEIGHT - 1;
-        }
+        new_line();
     }
 
     // Draw the character at current cursor position
-    const uint32_t index = cursor_y * VGA_WIDTH + cursor_x;
-    if (index < VGA_WIDTH * VGA_HEIGHT) {
-        uint8_t attr = (background_color << 4) | foreground_color;
-        VGA_BUFFER[index] = (uint16_t)c | ((uint16_t)attr << 8);
-    }
+    screen[cursor_y * VGA_WIDTH + cursor_x] = (uint16_t)(uint8_t)c | attribute();
 
     cursor_x++;
     update_cursor();
@@ -118,23 +141,60 @@ void Terminal::putChar(char c) {
 
 void Terminal::write(const char* str) {
     // Write a null-terminated string
-    for (uint32_t i = 0; str[i] != '\0'; ++i) {
-        putChar(str[i]);
+    write(str, strlen(str));
+}
+
+void Terminal::write(const char* data, uint32_t length) {
+    // Bulk output: printable characters are blitted in runs that end at a
+    // control character or at the right edge of the row, with the attribute
+    // computed once. The hardware cursor is programmed a single time at the
+    // end instead of after every character (each outb is a VM exit).
+    TRACE_SCOPE("term.write", length);
+    if (mirror && !viewing_history) mirror->write(data, length);
+
+    const uint16_t attr = attribute();
+    uint32_t i = 0;
+
+    while (i < length) {
+        if (is_control(data[i])) {
+            put_control(data[i++]);
+            continue;
+        }
+
+        if (cursor_x >= VGA_WIDTH) {
+            new_line();
+        }
+
+        volatile uint16_t* dst = screen + cursor_y * VGA_WIDTH + cursor_x;
+        uint32_t room = VGA_WIDTH - cursor_x;
+        if (room > length - i) room = length - i;
+
+        uint32_t run = 0;
+        while (run < room && !is_control(data[i + run])) {
+            dst[run] = (uint16_t)(uint8_t)data[i + run] | attr;
+            run++;
+        }
+
+        cursor_x += run;
+        i += run;
+        kstat_add(stat_cells_written, run);
     }
+
+    update_cursor();
+}
+
+void Terminal::put_at(char c, uint16_t x, uint16_t y) {
+    screen[y * VGA_WIDTH + x] = (uint16_t)(uint8_t)c | attribute();
 }
 
 void Terminal::writeAt(const char* str, uint16_t x, uint16_t y) {
-    // Write a string starting at position (x, y) without disturbing cursor state
+    // Write a string starting at position (x, y) without disturbing cursor
+    // state. Output stops at the end of the row or at a control character.
     if (x >= VGA_WIDTH || y >= VGA_HEIGHT) return;
 
-    uint16_t old_x = cursor_x, old_y = cursor_y;
-    setCursor(x, y);
-
-    for (uint32_t i = 0; str[i] != '\0' && cursor_x < VGA_WIDTH; ++i) {
-        putChar(str[i]);
+    for (uint32_t i = 0; str[i] != '\0' && x < VGA_WIDTH && !is_control(str[i]); ++i, ++x) {
+        put_at(str[i], x, y);
     }
-
-    setCursor(old_x, old_y);
 }
 
 void Terminal::setCursor(uint16_t x, uint16_t y) {
@@ -144,6 +204,9 @@ void Terminal::setCursor(uint16_t x, uint16_t y) {
     cursor_x = x;
     cursor_y = y;
     update_cursor();
+
+    // Full-screen views (top) position rows this way
+    if (mirror && !viewing_history) mirror->setCursor(x, y);
 }
 
 void Terminal::moveCursor(int16_t dx, int16_t dy) {
@@ -164,6 +227,9 @@ void Terminal::showCursor(bool show) {
 }
 
 void Terminal::update_cursor() {
+    // Only the terminal that owns the display may move the hardware cursor
+    if (!displayed || viewing_history) return;
+
     // Program VGA hardware cursor to follow cursor_x/cursor_y
     uint16_t pos = (uint16_t)(cursor_y * VGA_WIDTH + cursor_x);
     outb(0x3D4, 0x0F);
@@ -172,15 +238,21 @@ void Terminal::update_cursor() {
     outb(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
 }
 
-void Terminal::scrollUp(uint16_t lines) {
-    if (lines == 0) return;
+void Terminal::scroll_up(uint16_t lines) {
+    if (lines > VGA_HEIGHT) lines = VGA_HEIGHT;
+
+    // Keep the rows that fall off the top in the scrollback ring
+    for (uint16_t y = 0; y < lines; ++y) {
+        copy_cells(scrollback[scrollback_count % SCROLLBACK_LINES], screen + y * VGA_WIDTH, VGA_WIDTH);
+        scrollback_count++;
+    }
 
     // Move content up by 'lines'
     for (uint16_t y = 0; y < VGA_HEIGHT - lines; ++y) {
         for (uint16_t x = 0; x < VGA_WIDTH; ++x) {
             uint32_t src_index = (y + lines) * VGA_WIDTH + x;
             uint32_t dst_index = y * VGA_WIDTH + x;
-            VGA_BUFFER[dst_index] = VGA_BUFFER[src_index];
+            screen[dst_index] = screen[src_index];
         }
     }
 
@@ -188,26 +260,17 @@ void Terminal::scrollUp(uint16_t lines) {
     for (uint16_t y = VGA_HEIGHT - lines; y < VGA_HEIGHT; ++y) {
         clear_line(y);
     }
-
-    // Adjust cursor
-    if (cursor_y >= lines) {
-        cursor_y -= lines;
-    } else {
-        cursor_y = 0;
-    }
-
-    update_cursor();
 }
 
-void Terminal::scrollDown(uint16_t lines) {
-    if (lines == 0) return;
+void Terminal::scroll_down(uint16_t lines) {
+    if (lines > VGA_HEIGHT) lines = VGA_HEIGHT;
 
     // Move content down by 'lines'
     for (int16_t y = VGA_HEIGHT - 1; y >= lines; --y) {
         for (uint16_t x = 0; x < VGA_WIDTH; ++x) {
             uint32_t src_index = (y - lines) * VGA_WIDTH + x;
             uint32_t dst_index = y * VGA_WIDTH + x;
-            VGA_BUFFER[dst_index] = VGA_BUFFER[src_index];
+            screen[dst_index] = screen[src_index];
         }
     }
 
@@ -215,6 +278,27 @@ void Terminal::scrollDown(uint16_t lines) {
     for (uint16_t y = 0; y < lines; ++y) {
         clear_line(y);
     }
+}
+
+void Terminal::scrollUp(uint16_t lines) {
+    if (lines == 0) return;
+
+    scroll_up(lines);
+
+    // Adjust cursor
+    if (cursor_y >= lines) {
+        cursor_y -= lines;
+    } else {
+        cursor_y = 0;
+    }
+
+    update_cursor();
+}
+
+void Terminal::scrollDown(uint16_t lines) {
+    if (lines == 0) return;
+
+    scroll_down(lines);
 
     // Adjust cursor
     cursor_y += lines;
@@ -225,11 +309,77 @@ void Terminal::scrollDown(uint16_t lines) {
     update_cursor();
 }
 
+void Terminal::show(bool keep_display) {
+    if (displayed) return;
+
+    // keep_display adopts whatever is already on screen (boot banner)
+    if (!keep_display) {
+        copy_cells(VGA_BUFFER, cells, VGA_WIDTH * VGA_HEIGHT);
+    }
+    screen = VGA_BUFFER;
+    displayed = true;
+    viewing_history = false;
+    scroll_offset = 0;
+    update_cursor();
+}
+
+void Terminal::hide() {
+    if (!displayed) return;
+
+    // While browsing history the live screen is already in 'cells'
+    if (!viewing_history) {
+        copy_cells(cells, VGA_BUFFER, VGA_WIDTH * VGA_HEIGHT);
+    }
+    screen = cells;
+    displayed = false;
+    viewing_history = false;
+    scroll_offset = 0;
+}
+
+void Terminal::setScrollOffset(uint16_t offset) {
+    uint32_t history = (scrollback_count < SCROLLBACK_LINES) ? scrollback_count : SCROLLBACK_LINES;
+    if (offset > history) offset = history;
+    if (!displayed || offset == scroll_offset) return;
+
+    if (offset > 0 && !viewing_history) {
+        // Park live output in the back buffer while history is on screen
+        copy_cells(cells, VGA_BUFFER, VGA_WIDTH * VGA_HEIGHT);
+        screen = cells;
+        viewing_history = true;
+    }
+
+    scroll_offset = offset;
+
+    if (offset == 0) {
+        copy_cells(VGA_BUFFER, cells, VGA_WIDTH * VGA_HEIGHT);
+        screen = VGA_BUFFER;
+        viewing_history = false;
+        update_cursor();
+        // The mirror was not written while history was up; catch it up
+        if (mirror) mirror->renderText(cells, VGA_WIDTH, VGA_HEIGHT, cursor_x, cursor_y);
+        return;
+    }
+
+    render_history();
+}
+
+void Terminal::render_history() {
+    // Row r shows live row (r - offset), or scrollback when that is negative
+    for (int32_t r = 0; r < VGA_HEIGHT; ++r) {
+        int32_t line = r - scroll_offset;
+        const uint16_t* src = (line >= 0)
+            ? &cells[line * VGA_WIDTH]
+            : scrollback[(scrollback_count + line) % SCROLLBACK_LINES];
+        copy_cells(VGA_BUFFER + r * VGA_WIDTH, src, VGA_WIDTH);
+        if (mirror) mirror->renderRow((uint16_t)r, src, VGA_WIDTH);
+    }
+    if (mirror) mirror->flush();
+}
+
 void Terminal::clear_line(uint16_t y) {
+    const uint16_t blank = (uint16_t)' ' | attribute();
     for (uint16_t x = 0; x < VGA_WIDTH; ++x) {
-        uint32_t index = y * VGA_WIDTH + x;
-        uint16_t attr = ((uint16_t)(background_color << 4) | (uint16_t)foreground_color) << 8;
-        VGA_BUFFER[index] = (uint16_t)' ' | attr;
+        screen[y * VGA_WIDTH + x] = blank;
     }
 }
 
@@ -282,14 +432,14 @@ void Terminal::drawBox(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, char
 
     // Horizontal borders
     for (uint16_t x = x1; x <= x2; ++x) {
-        writeAt(&border_char, x, y1);
-        writeAt(&border_char, x, y2);
+        put_at(border_char, x, y1);
+        put_at(border_char, x, y2);
     }
 
     // Vertical borders
     for (uint16_t y = y1; y <= y2; ++y) {
-        writeAt(&border_char, x1, y);
-        writeAt(&border_char, x2, y);
+        put_at(border_char, x1, y);
+        put_at(border_char, x2, y);
     }
 }
 
@@ -298,7 +448,7 @@ void Terminal::fillArea(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, char
 
     for (uint16_t y = y1; y <= y2; ++y) {
         for (uint16_t x = x1; x <= x2; ++x) {
-            writeAt(&fill_char, x, y);
+            put_at(fill_char, x, y);
         }
     }
 }
@@ -6,12 +6,16 @@
 
 #include "keyboard.h"
 
+class FramebufferConsole;
+
 /*
  * Terminal (text-mode) interface for RusticOS
  * -------------------------------------------
  * - Provides a simple, buffered VGA text-mode console
  * - Supports writing strings, cursor positioning, scrolling, and a basic
  *   interactive input mode
+ * - Each Terminal owns a back buffer and a scrollback ring; while it is not
+ *   on display all output lands in RAM, and show() blits it to VGA
  * - Intended for educational use; not optimized
  */
 
@@ -48,10 +52,17 @@ private:
     uint8_t background_color;        // background color
     bool cursor_visible;             // whether to render the cursor
 
-    // Simple scroll buffer (reserved for future use)
-    static const uint16_t SCROLL_BUFFER_SIZE = VGA_HEIGHT * 2;
-    uint16_t scroll_buffer[SCROLL_BUFFER_SIZE];
-    uint16_t scroll_offset;
+    // Output target: VGA_BUFFER while displayed, 'cells' otherwise
+    volatile uint16_t* screen;
+    uint16_t cells[VGA_WIDTH * VGA_HEIGHT];
+    bool displayed;                  // owns the VGA text buffer
+    bool viewing_history;            // displayed, but showing scrollback
+
+    // Lines scrolled off the top, oldest overwritten first
+    static const uint16_t SCROLLBACK_LINES = 100;
+    uint16_t scrollback[SCROLLBACK_LINES][VGA_WIDTH];
+    uint32_t scrollback_count;       // total lines ever pushed
+    uint16_t scroll_offset;          // lines scrolled back from the live view
 
     // Input buffer for simple line input mode
     static const uint16_t INPUT_BUFFER_SIZE = 256;
@@ -59,11 +70,27 @@ private:
     uint16_t input_pos;
     bool input_mode;
 
+    // Optional pixel console that receives the same stream output (not
+    // while history is on screen; leaving history re-renders it)
+    FramebufferConsole* mirror;
+
     // Internal helpers
-    void scroll_up();
-    void scroll_down();
+    // The helpers below only touch video memory; callers decide when to
+    // program the hardware cursor so that bulk output pays for it once.
+    void scroll_up(uint16_t lines);
+    void scroll_down(uint16_t lines);
     void update_cursor();
     void clear_line(uint16_t y);
+    void new_line();
+    void put_control(char c);
+    void put_at(char c, uint16_t x, uint16_t y);
+    void render_history();
+    uint16_t attribute() const {
+        return (uint16_t)(((background_color << 4) | foreground_color) << 8);
+    }
+    static bool is_control(char c) {
+        return c == '\n' || c == '\r' || c == '\t' || c == '\b';
+    }
 
 public:
     Terminal();
@@ -73,7 +100,9 @@ public:
     void setColor(uint8_t fg, uint8_t bg = BLACK);
     void putChar(char c);
     void write(const char* str);
+    void write(const char* data, uint32_t length);
     void writeAt(const char* str, uint16_t x, uint16_t y);
+    void setMirror(FramebufferConsole* console) { mirror = console; }
 
     // Cursor control
     void setCursor(uint16_t x, uint16_t y);
@@ -85,6 +114,13 @@ public:
     void scrollUp(uint16_t lines = 1);
     void scrollDown(uint16_t lines = 1);
     void setScrollOffset(uint16_t offset);
+    uint16_t getScrollOffset() const { return scroll_offset; }
+
+    // Display ownership (see VirtualConsoles)
+    void show(bool keep_display = false);   // blit back buffer to VGA and write there
+    void hide();                            // save VGA and continue in RAM
+    bool isDisplayed() const { return displayed; }
+    const uint16_t* getCells() const { return cells; }   // valid while hidden
 
     // Input handling
     void enableInput(bool enable);
@@ -0,0 +1,712 @@
+/*
+ * RusticOS kernel threads
+ * -----------------------
+ * Pool, per-CPU priority run queues, wait queues and the timer-driven
+ * preemption path. Every scheduling decision runs with interrupts disabled,
+ * because IRQ handlers may make threads runnable at any time, and each
+ * CPU's queues are guarded by its own spinlock, because other CPUs wake
+ * threads onto them and steal from them.
+ *
+ * A thread that is switching out still runs on its stack after it has
+ * been queued (or woken by another CPU), so Thread::on_cpu stays set until
+ * thread_switch has saved its registers. Only the thread's own CPU may
+ * take it from the queue in that window (and waits for the flag): a CPU
+ * that stole it and spun could wait on a CPU spinning on one of its own.
+ */
+
+#include "thread.h"
+#include "interrupts.h"
+#include "clock.h"
+#include "cpu.h"
+#include "io.h"
+#include "smp.h"
+#include "klog.h"
+#include "kprintf.h"
+#include "kstats.h"
+#include "stream.h"
+#include <cstring>
+
+extern "C" void thread_switch(uint32_t* save_esp, uint32_t load_esp, volatile uint32_t* prev_on_cpu);
+
+#define FPU_STATE_SIZE 512
+
+static Thread threads[MAX_THREADS];
+static uint8_t stacks[MAX_THREADS][THREAD_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t fpu_states[MAX_THREADS][FPU_STATE_SIZE] __attribute__((aligned(16)));
+
+// Ticks per slice for each level: urgent work gets short slices, batch
+// work longer ones so it is not switched more than needed
+static const uint8_t SLICE_TICKS[PRIORITY_LEVELS] = { 2, 5, 10 };
+
+struct CpuSched {
+    Thread* current;
+    Thread* idle;
+    ThreadQueue run_queues[PRIORITY_LEVELS];
+    Spinlock lock;                  // run_queues and stealable
+    uint32_t stealable;             // unpinned threads in run_queues
+    volatile bool need_resched;
+    volatile bool online;
+    uint32_t preempt_count;
+    uint32_t ticks;
+    uint32_t switches;
+    uint32_t steals;
+};
+
+static CpuSched sched_cpus[MAX_CPUS];
+static Spinlock pool_lock;          // slot allocation in setup_thread()
+static uint32_t next_id = 0;
+static bool save_fpu = false;
+
+KSTAT_COUNTER(stat_context_switches, "sched.switches");
+KSTAT_COUNTER(stat_preemptions, "sched.preemptions");
+KSTAT_COUNTER(stat_steals, "sched.steals");
+KSTAT_GAUGE(stat_threads, "sched.threads");
+
+// Only meaningful with interrupts disabled: otherwise the caller could be
+// preempted and resumed on another CPU
+static inline CpuSched& this_cpu() {
+    return sched_cpus[cpu_index()];
+}
+
+// State changes that other CPUs observe (SLEEPING, BLOCKED) are published
+// after the fields they depend on, such as wake_tick
+static inline void set_state(Thread* thread, ThreadState state) {
+    __atomic_store_n(&thread->state, state, __ATOMIC_RELEASE);
+}
+
+// A waker and the sleep tick can race for the same thread; only one of
+// them gets to make it runnable
+static inline bool claim_wakeup(Thread* thread, ThreadState from) {
+    ThreadState expected = from;
+    return __atomic_compare_exchange_n(&thread->state, &expected, THREAD_READY, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// thread_block() taking back a wake that came in before it blocked
+static inline bool claim_running(Thread* thread) {
+    ThreadState expected = THREAD_BLOCKED;
+    return __atomic_compare_exchange_n(&thread->state, &expected, THREAD_RUNNING, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------
+// Queues
+// ---------------------------------------------------------------------------
+
+void ThreadQueue::push(Thread* thread) {
+    thread->next = nullptr;
+    if (tail) {
+        tail->next = thread;
+    } else {
+        head = thread;
+    }
+    tail = thread;
+}
+
+Thread* ThreadQueue::pop() {
+    Thread* thread = head;
+    if (thread) {
+        head = thread->next;
+        if (!head) tail = nullptr;
+        thread->next = nullptr;
+    }
+    return thread;
+}
+
+Thread* ThreadQueue::pop_unpinned() {
+    Thread* prev = nullptr;
+    for (Thread* thread = head; thread; prev = thread, thread = thread->next) {
+        // A thread still switching out belongs to its home CPU, see steal()
+        if (thread->pinned || __atomic_load_n(&thread->on_cpu, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        if (prev) {
+            prev->next = thread->next;
+        } else {
+            head = thread->next;
+        }
+        if (tail == thread) tail = prev;
+        thread->next = nullptr;
+        return thread;
+    }
+    return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// Scheduler core (interrupts disabled)
+// ---------------------------------------------------------------------------
+
+// Queue a thread on the CPU it last ran on
+static void make_ready(Thread* thread) {
+    CpuSched& c = sched_cpus[thread->cpu];
+    c.lock.lock();
+    thread->state = THREAD_READY;
+    c.run_queues[thread->effective].push(thread);
+    if (!thread->pinned) c.stealable++;
+    c.lock.unlock();
+}
+
+// Lowest non-empty level, or PRIORITY_LEVELS when nothing is queued. Reads
+// without the lock are a hint only.
+static uint32_t best_ready_level(const CpuSched& c) {
+    for (uint32_t level = 0; level < PRIORITY_LEVELS; ++level) {
+        if (!c.run_queues[level].empty()) return level;
+    }
+    return PRIORITY_LEVELS;
+}
+
+// A thread woken from a wait runs one level up for its next slice
+static void wake_boosted(Thread* thread) {
+    thread->effective = (thread->priority > PRIORITY_HIGH) ? thread->priority - 1 : PRIORITY_HIGH;
+    thread->slice_left = SLICE_TICKS[thread->effective];
+    uint8_t effective = thread->effective;
+    CpuSched& c = sched_cpus[thread->cpu];
+    make_ready(thread);
+
+    // No IPIs: another CPU notices on its next interrupt
+    Thread* running = c.current;
+    if (running == c.idle || effective < running->effective) {
+        c.need_resched = true;
+    }
+}
+
+static Thread* pop_local(CpuSched& c) {
+    c.lock.lock();
+    Thread* thread = nullptr;
+    uint32_t level = best_ready_level(c);
+    if (level < PRIORITY_LEVELS) {
+        thread = c.run_queues[level].pop();
+        if (!thread->pinned) c.stealable--;
+    }
+    c.lock.unlock();
+    return thread;
+}
+
+// Take the most urgent unpinned thread from the first CPU that has one.
+// Threads whose CPU is still switching them out are left alone, so the
+// on_cpu spin in schedule() only ever waits for this CPU's own switch.
+static Thread* steal(uint32_t cpu) {
+    for (uint32_t i = 1; i < MAX_CPUS; ++i) {
+        CpuSched& victim = sched_cpus[(cpu + i) % MAX_CPUS];
+        if (!victim.online || victim.stealable == 0) {
+            continue;
+        }
+        Thread* thread = nullptr;
+        victim.lock.lock();
+        for (uint32_t level = 0; level < PRIORITY_LEVELS && !thread; ++level) {
+            thread = victim.run_queues[level].pop_unpinned();
+        }
+        if (thread) victim.stealable--;
+        victim.lock.unlock();
+        if (thread) {
+            sched_cpus[cpu].steals++;
+            kstat_inc(stat_steals);
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+static bool work_available(uint32_t cpu) {
+    if (best_ready_level(sched_cpus[cpu]) < PRIORITY_LEVELS) {
+        return true;
+    }
+    for (uint32_t i = 0; i < MAX_CPUS; ++i) {
+        if (i != cpu && sched_cpus[i].online && sched_cpus[i].stealable > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Switch to the most urgent runnable thread, stealing one if the local
+// queues are empty. The caller has already queued or parked 'current'; the
+// idle thread runs when there is nothing else.
+static void schedule() {
+    uint32_t cpu = cpu_index();
+    CpuSched& c = sched_cpus[cpu];
+    Thread* prev = c.current;
+
+    Thread* next = pop_local(c);
+    if (!next) next = steal(cpu);
+    if (!next) next = c.idle;
+
+    c.need_resched = false;
+    if (next == prev) {
+        next->state = THREAD_RUNNING;
+        return;
+    }
+
+    // Local threads last ran here and steal() skips any thread still
+    // switching out elsewhere, so this never waits on another CPU
+    while (__atomic_load_n(&next->on_cpu, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+    next->state = THREAD_RUNNING;
+    next->cpu = (uint8_t)cpu;
+    next->on_cpu = 1;
+    next->switches++;
+    c.switches++;
+    kstat_inc(stat_context_switches);
+    c.current = next;
+    thread_switch(&prev->esp, next->esp, &prev->on_cpu);
+}
+
+// Put 'current' back in its queue. A used-up slice ends any wake boost.
+static void requeue_current(CpuSched& c) {
+    Thread* self = c.current;
+    if (self == c.idle) {
+        self->state = THREAD_READY;
+        return;
+    }
+    if (self->slice_left == 0) {
+        self->effective = self->priority;
+        self->slice_left = SLICE_TICKS[self->effective];
+    }
+    make_ready(self);
+}
+
+static inline void fpu_save(uint8_t* area) {
+    __asm__ __volatile__("fxsave (%0)" : : "r"(area) : "memory");
+}
+
+static inline void fpu_restore(const uint8_t* area) {
+    __asm__ __volatile__("fxrstor (%0)" : : "r"(area) : "memory");
+}
+
+void sched_timer_tick() {
+    CpuSched& c = this_cpu();
+    c.ticks++;
+    Thread* running = c.current;
+    if (!running || running == c.idle) {
+        return;
+    }
+    if (running->slice_left > 0) {
+        running->slice_left--;
+    }
+    if (running->slice_left == 0) {
+        c.need_resched = true;
+    }
+}
+
+// IRQ0 on the boot CPU: end sleeps on every CPU, then charge CPU 0
+static void sched_clock_tick() {
+    uint32_t now = clock_ticks();
+    for (uint32_t i = 0; i < MAX_THREADS; ++i) {
+        Thread& thread = threads[i];
+        if (thread.state == THREAD_SLEEPING && (int32_t)(now - thread.wake_tick) >= 0 &&
+            claim_wakeup(&thread, THREAD_SLEEPING)) {
+            wake_boosted(&thread);
+        }
+    }
+    sched_timer_tick();
+}
+
+void sched_irq_exit() {
+    CpuSched& c = this_cpu();
+    if (!c.need_resched || c.preempt_count > 0 || !c.current) {
+        return;
+    }
+
+    // The interrupted thread may be in the middle of SSE code; its state
+    // is restored below, when this thread is eventually switched back to
+    Thread* self = c.current;
+    if (save_fpu) fpu_save(self->fpu);
+
+    if (self != c.idle) {
+        self->preemptions++;
+        kstat_inc(stat_preemptions);
+    }
+    requeue_current(c);
+    schedule();
+
+    if (save_fpu) fpu_restore(self->fpu);
+}
+
+// First code run on a new thread's stack (thread_switch "returns" here)
+static void thread_bootstrap() {
+    Thread* self = this_cpu().current;
+    interrupts_enable();
+    self->entry(self->arg);
+    thread_exit();
+}
+
+static void idle_main(void*) {
+    for (;;) {
+        interrupts_disable();
+        if (work_available(cpu_index())) {
+            interrupts_enable();
+            thread_yield();
+            continue;
+        }
+        // STI takes effect after HLT starts, so a wakeup cannot slip in between
+        __asm__ __volatile__("sti; hlt" : : : "memory");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+// Claim a free slot and build its initial stack frame (interrupts disabled).
+// A dead thread's slot is free once its CPU has switched away from it.
+static Thread* setup_thread(const char* name, ThreadEntry entry, void* arg, ThreadPriority priority) {
+    pool_lock.lock();
+    Thread* thread = nullptr;
+    uint32_t slot = 0;
+    for (uint32_t i = 1; i < MAX_THREADS; ++i) {
+        ThreadState state = threads[i].state;
+        if (state == THREAD_UNUSED || (state == THREAD_DEAD && !threads[i].on_cpu)) {
+            thread = &threads[i];
+            slot = i;
+            break;
+        }
+    }
+    if (!thread) {
+        pool_lock.unlock();
+        return nullptr;
+    }
+
+    thread->id = next_id++;
+    strncpy(thread->name, name, THREAD_NAME_MAX - 1);
+    thread->name[THREAD_NAME_MAX - 1] = '\0';
+    thread->entry = entry;
+    thread->arg = arg;
+    thread->stack = stacks[slot];
+    thread->fpu = fpu_states[slot];
+    thread->switches = 0;
+    thread->preemptions = 0;
+    thread->priority = priority;
+    thread->effective = priority;
+    thread->slice_left = SLICE_TICKS[priority];
+    thread->cpu = (uint8_t)cpu_index();
+    thread->pinned = false;
+    thread->on_cpu = 0;
+    thread->wake_pending = 0;
+
+    // Zeroed so threads_print() can find the deepest word ever written
+    memset(thread->stack, 0, THREAD_STACK_SIZE);
+
+    // Initial frame as thread_switch expects it: edi, esi, ebx, ebp, then
+    // the return address. The word above it is thread_bootstrap's (unused)
+    // return address and keeps the entry stack 16-byte aligned like a call.
+    uint32_t* sp = (uint32_t*)(thread->stack + THREAD_STACK_SIZE);
+    *--sp = 0;
+    *--sp = (uint32_t)thread_bootstrap;
+    *--sp = 0;  // ebp
+    *--sp = 0;  // ebx
+    *--sp = 0;  // esi
+    *--sp = 0;  // edi
+    thread->esp = (uint32_t)sp;
+
+    thread->state = THREAD_READY;
+    pool_lock.unlock();
+    kstat_add(stat_threads, 1);
+    return thread;
+}
+
+Thread* thread_create(const char* name, ThreadEntry entry, void* arg, ThreadPriority priority) {
+    uint32_t flags = irq_save();
+    Thread* thread = setup_thread(name, entry, arg, priority);
+    if (thread) {
+        uint8_t effective = thread->effective;
+        make_ready(thread);
+        CpuSched& c = this_cpu();
+        if (effective < c.current->effective) {
+            c.need_resched = true;
+        }
+    }
+    irq_restore(flags);
+    return thread;
+}
+
+// Never queued: schedule() falls back to it when there is nothing to run
+static Thread* create_idle(uint32_t cpu) {
+    char name[THREAD_NAME_MAX];
+    ksnprintf(name, sizeof(name), "idle%u", cpu);
+    uint32_t flags = irq_save();
+    Thread* idle = setup_thread(name, idle_main, nullptr, PRIORITY_LOW);
+    irq_restore(flags);
+    if (idle) {
+        idle->cpu = (uint8_t)cpu;
+        idle->pinned = true;
+    }
+    return idle;
+}
+
+void threads_init() {
+    CpuSched& boot = sched_cpus[0];
+
+    Thread* main = &threads[0];
+    main->id = next_id++;
+    strncpy(main->name, "main", THREAD_NAME_MAX);
+    main->state = THREAD_RUNNING;
+    main->stack = nullptr;
+    main->fpu = fpu_states[0];
+    main->priority = main->effective = PRIORITY_NORMAL;
+    main->slice_left = SLICE_TICKS[PRIORITY_NORMAL];
+    // The console, shell and keyboard wait all assume the boot CPU
+    main->cpu = 0;
+    main->pinned = true;
+    main->on_cpu = 1;
+    boot.current = main;
+    kstat_set(stat_threads, 1);
+
+    save_fpu = (cpuid_features_edx() & CPUID_EDX_FXSR) != 0;
+
+    boot.idle = create_idle(0);
+    boot.online = true;
+
+    // Preemption starts once kernel_main enables interrupts
+    clock_set_tick_handler(sched_clock_tick);
+    clock_start_periodic(SCHED_TICK_HZ);
+
+    klog.logf(LOG_INFO, "threads: %u slots, %u byte stacks, %u Hz tick",
+              MAX_THREADS, THREAD_STACK_SIZE, SCHED_TICK_HZ);
+}
+
+uint32_t sched_prepare_cpu(uint32_t cpu) {
+    CpuSched& c = sched_cpus[cpu];
+    // Reused when the previous CPU given this index failed to start
+    if (!c.idle) {
+        c.idle = create_idle(cpu);
+        if (!c.idle) {
+            return 0;
+        }
+    }
+    return (uint32_t)(c.idle->stack + THREAD_STACK_SIZE);
+}
+
+void sched_ap_enter(uint32_t cpu) {
+    CpuSched& c = sched_cpus[cpu];
+    Thread* idle = c.idle;
+    idle->state = THREAD_RUNNING;
+    idle->on_cpu = 1;
+    c.current = idle;
+    __atomic_store_n(&c.online, true, __ATOMIC_RELEASE);
+
+    idle_main(nullptr);
+    __builtin_unreachable();
+}
+
+bool sched_cpu_online(uint32_t cpu) {
+    return __atomic_load_n(&sched_cpus[cpu].online, __ATOMIC_ACQUIRE);
+}
+
+void thread_set_priority(Thread* thread, ThreadPriority priority) {
+    uint32_t flags = irq_save();
+    CpuSched& c = this_cpu();
+    thread->priority = priority;
+    // Queued threads keep their place; the new level applies from the next slice
+    if (thread->state != THREAD_READY) {
+        thread->effective = priority;
+    }
+    if (thread == c.current && best_ready_level(c) < priority) {
+        c.need_resched = true;
+    }
+    irq_restore(flags);
+}
+
+void thread_pin(Thread* thread) {
+    uint32_t flags = irq_save();
+    CpuSched& c = sched_cpus[thread->cpu];
+    c.lock.lock();
+    if (!thread->pinned) {
+        thread->pinned = true;
+        // Already queued: it no longer counts as stealable
+        for (uint32_t level = 0; level < PRIORITY_LEVELS; ++level) {
+            for (Thread* queued = c.run_queues[level].head; queued; queued = queued->next) {
+                if (queued == thread) c.stealable--;
+            }
+        }
+    }
+    c.lock.unlock();
+    irq_restore(flags);
+}
+
+void thread_yield() {
+    uint32_t flags = irq_save();
+    requeue_current(this_cpu());
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_sleep_ms(uint32_t ms) {
+    uint32_t ticks = (ms * SCHED_TICK_HZ + 999) / 1000;
+    if (ticks == 0) ticks = 1;
+
+    uint32_t flags = irq_save();
+    Thread* self = this_cpu().current;
+    self->wake_tick = clock_ticks() + ticks;
+    set_state(self, THREAD_SLEEPING);
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_exit() {
+    interrupts_disable();
+    set_state(this_cpu().current, THREAD_DEAD);
+    kstat_sub(stat_threads, 1);
+    schedule();
+    for (;;) {
+        __asm__ __volatile__("hlt");
+    }
+}
+
+void thread_block() {
+    uint32_t flags = irq_save();
+    Thread* self = this_cpu().current;
+    set_state(self, THREAD_BLOCKED);
+    // Pairs with thread_wake(): either it sees BLOCKED and queues us, or we
+    // see its wake_pending and take ourselves back
+    if (__atomic_exchange_n(&self->wake_pending, 0, __ATOMIC_SEQ_CST) &&
+        claim_running(self)) {
+        irq_restore(flags);
+        return;
+    }
+    schedule();
+    irq_restore(flags);
+}
+
+void thread_wake(Thread* thread) {
+    uint32_t flags = irq_save();
+    if (!claim_wakeup(thread, THREAD_BLOCKED)) {
+        __atomic_store_n(&thread->wake_pending, 1, __ATOMIC_SEQ_CST);
+        // It may have blocked before seeing the flag
+        if (!claim_wakeup(thread, THREAD_BLOCKED)) {
+            irq_restore(flags);
+            return;
+        }
+    }
+    wake_boosted(thread);
+    irq_restore(flags);
+}
+
+Thread* thread_current() {
+    uint32_t flags = irq_save();
+    Thread* self = this_cpu().current;
+    irq_restore(flags);
+    return self;
+}
+
+void preempt_disable() {
+    uint32_t flags = irq_save();
+    this_cpu().preempt_count++;
+    irq_restore(flags);
+}
+
+void preempt_enable() {
+    uint32_t flags = irq_save();
+    CpuSched& c = this_cpu();
+    c.preempt_count--;
+    // Catch up on a preemption that was held off, unless called with
+    // interrupts disabled (the next IRQ exit will do it)
+    if (c.preempt_count == 0 && c.need_resched && (flags & EFLAGS_IF)) {
+        requeue_current(c);
+        schedule();
+    }
+    irq_restore(flags);
+}
+
+// ---------------------------------------------------------------------------
+// Wait queues
+// ---------------------------------------------------------------------------
+
+void WaitQueue::wait() {
+    uint32_t flags = irq_save();
+    Thread* self = this_cpu().current;
+    lock.lock();
+    set_state(self, THREAD_BLOCKED);
+    waiters.push(self);
+    lock.unlock();
+    // A waker on another CPU may already have made it runnable again;
+    // schedule() then either picks it straight back or leaves it queued
+    schedule();
+    irq_restore(flags);
+}
+
+bool WaitQueue::wake_one() {
+    uint32_t flags = lock.lock_irqsave();
+    Thread* thread = waiters.pop();
+    lock.unlock();
+    if (thread) {
+        thread_wake(thread);
+    }
+    irq_restore(flags);
+    return thread != nullptr;
+}
+
+uint32_t WaitQueue::wake_all() {
+    uint32_t flags = lock.lock_irqsave();
+    ThreadQueue woken_queue = waiters;
+    waiters.head = waiters.tail = nullptr;
+    lock.unlock();
+
+    uint32_t woken = 0;
+    while (Thread* thread = woken_queue.pop()) {
+        thread_wake(thread);
+        woken++;
+    }
+    irq_restore(flags);
+    return woken;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+void sched_cpu_stats(uint32_t cpu, SchedCpuStats& stats) {
+    const CpuSched& c = sched_cpus[cpu];
+    stats.ticks = c.ticks;
+    stats.switches = c.switches;
+    stats.steals = c.steals;
+    Thread* running = c.current;
+    stats.running = running ? running->name : "-";
+}
+
+static const char* state_name(ThreadState state) {
+    switch (state) {
+    case THREAD_READY:    return "ready";
+    case THREAD_RUNNING:  return "running";
+    case THREAD_BLOCKED:  return "blocked";
+    case THREAD_SLEEPING: return "sleeping";
+    case THREAD_DEAD:     return "dead";
+    default:              return "unused";
+    }
+}
+
+static const char* priority_name(uint8_t priority) {
+    switch (priority) {
+    case PRIORITY_HIGH:   return "high";
+    case PRIORITY_NORMAL: return "normal";
+    default:              return "low";
+    }
+}
+
+// Bytes of stack that have ever been written (stacks start zeroed)
+static uint32_t stack_high_water(const Thread& thread) {
+    const uint32_t* words = (const uint32_t*)thread.stack;
+    uint32_t i = 0;
+    while (i < THREAD_STACK_SIZE / 4 && words[i] == 0) i++;
+    return THREAD_STACK_SIZE - i * 4;
+}
+
+void threads_print(OutputStream& out) {
+    kfprintf(out, "%4s %-16s %-6s %-8s %3s %10s %8s %s\n",
+             "ID", "NAME", "PRI", "STATE", "CPU", "SWITCHES", "PREEMPT", "STACK");
+    for (uint32_t i = 0; i < MAX_THREADS; ++i) {
+        const Thread& thread = threads[i];
+        if (thread.state == THREAD_UNUSED || thread.state == THREAD_DEAD) {
+            continue;
+        }
+        kfprintf(out, "%4u %-16s %-6s %-8s %2u%c %10u %8u ", thread.id, thread.name,
+                 priority_name(thread.priority), state_name(thread.state),
+                 thread.cpu, thread.pinned ? '*' : ' ',
+                 thread.switches, thread.preemptions);
+        if (thread.stack) {
+            kfprintf(out, "%u/%u\n", stack_high_water(thread), THREAD_STACK_SIZE);
+        } else {
+            kfprintf(out, "boot\n");
+        }
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "types.h"
+#include "spinlock.h"
+
+class OutputStream;
+
+/*
+ * Kernel threads and the preemptive scheduler
+ * -------------------------------------------
+ * - threads_init() turns the boot context (kernel_main on the crt0 stack)
+ *   into the "main" thread, creates an idle thread that halts the CPU
+ *   whenever nothing is runnable, and starts the SCHED_TICK_HZ tick on IRQ0
+ * - Threads come from a fixed pool with fixed-size stacks; there is no
+ *   allocation after boot. A thread that returns from its entry function
+ *   exits, and its slot is reused by a later thread_create()
+ * - Strict priorities, round-robin within a level. A thread runs until it
+ *   yields, blocks, sleeps, or its time slice (longer for lower levels)
+ *   runs out, in which case it is preempted on the way out of the tick
+ * - A thread woken from a wait queue or sleep runs one level higher for
+ *   its next slice, and preempts the current thread at once when that
+ *   makes it more urgent. This keeps the shell, which wakes on keyboard
+ *   input, responsive while CPU-bound work runs at normal or low priority
+ * - Every CPU has its own run queues (under a spinlock), idle thread and
+ *   tick: IRQ0 on the boot CPU, the local APIC timer on the others. New and
+ *   woken threads are queued on the CPU they last ran on; a CPU whose
+ *   queues are empty steals the most urgent unpinned thread from another
+ *   CPU instead of idling. There are no IPIs, so a thread queued for an
+ *   idle CPU waits for that CPU's next tick at the latest
+ * - "main" owns the console and keyboard and is pinned to the boot CPU,
+ *   where their IRQs arrive; thread_pin() pins other threads the same way
+ * - thread_wake() and WaitQueue::wake_*() may be called from IRQ handlers
+ * - preempt_disable()/preempt_enable() keep the current thread on its CPU
+ *   (IRQs still run) around code that is not safe to interleave; a thread
+ *   must not block or yield while preemption is disabled. Other CPUs keep
+ *   running: data they share needs a Spinlock
+ * - Preemption saves and restores FPU/SSE state with FXSAVE, since it can
+ *   land in the middle of SSE code; voluntary switches do not need to
+ * - The register switch itself is thread_switch in switch.s
+ */
+
+#define MAX_THREADS        32
+#define THREAD_STACK_SIZE  8192
+#define THREAD_NAME_MAX    16
+
+#define SCHED_TICK_HZ      100
+
+enum ThreadPriority {
+    PRIORITY_HIGH = 0,
+    PRIORITY_NORMAL,
+    PRIORITY_LOW,
+    PRIORITY_LEVELS
+};
+
+enum ThreadState {
+    THREAD_UNUSED = 0,
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_SLEEPING,
+    THREAD_DEAD,
+};
+
+typedef void (*ThreadEntry)(void* arg);
+
+struct Thread {
+    uint32_t esp;               // saved stack pointer while switched out
+    uint32_t id;
+    char name[THREAD_NAME_MAX];
+    ThreadState state;
+    ThreadEntry entry;
+    void* arg;
+    uint8_t* stack;             // lowest address of the stack (nullptr: boot stack)
+    Thread* next;               // run queue or wait queue link
+    uint32_t switches;          // times switched to
+    uint32_t preemptions;       // times its slice ran out or it was displaced
+    uint8_t priority;           // base ThreadPriority
+    uint8_t effective;          // priority for the current slice (boosted on wake)
+    uint8_t slice_left;         // ticks left in the current slice
+    uint32_t wake_tick;         // clock_ticks() value that ends a sleep
+    uint8_t* fpu;               // 512-byte FXSAVE area
+    uint8_t cpu;                // CPU it runs or last ran on
+    bool pinned;                // never stolen by another CPU
+    volatile uint32_t on_cpu;   // set until its registers are saved on switch-out;
+                                // only its own CPU dequeues it meanwhile (no steals)
+    uint32_t wake_pending;      // thread_wake() arrived while it was not blocked
+};
+
+// Intrusive FIFO of threads, linked through Thread::next
+struct ThreadQueue {
+    Thread* head;
+    Thread* tail;
+
+    bool empty() const { return head == nullptr; }
+    void push(Thread* thread);
+    Thread* pop();
+    Thread* pop_unpinned();     // skips pinned threads and any still on_cpu
+};
+
+class WaitQueue {
+private:
+    ThreadQueue waiters;
+    Spinlock lock;
+
+public:
+    WaitQueue() : waiters{nullptr, nullptr} {}
+
+    /**
+     * Block the current thread until woken. To wait for a condition without
+     * missing a wakeup, disable interrupts, test the condition, and call
+     * wait() in a loop; the flags are restored when wait() returns.
+     * Disabling interrupts only holds off wakers on the same CPU, so this
+     * suits conditions set by IRQ handlers on the CPU the waiter is
+     * pinned to (keyboard input and "main" on the boot CPU).
+     */
+    void wait();
+
+    // Make the longest waiter runnable; returns false if nobody was waiting
+    bool wake_one();
+    uint32_t wake_all();
+
+    bool empty() const { return waiters.empty(); }
+};
+
+void threads_init();
+
+// Returns nullptr when every slot is in use
+Thread* thread_create(const char* name, ThreadEntry entry, void* arg,
+                      ThreadPriority priority = PRIORITY_NORMAL);
+void thread_set_priority(Thread* thread, ThreadPriority priority);
+
+// Keep a thread on the CPU it last ran on (its creator's, if it never ran)
+void thread_pin(Thread* thread);
+
+void thread_yield();
+void thread_sleep_ms(uint32_t ms);
+void thread_exit() __attribute__((noreturn));
+
+// Park the current thread until someone holding its Thread* calls
+// thread_wake(). A wake that arrives first is remembered and makes the next
+// thread_block() return at once, so "check for work, else block" loops
+// cannot miss one; they must recheck, since a return may be a stale wake.
+// Threads sleeping in a WaitQueue are woken through it.
+void thread_block();
+void thread_wake(Thread* thread);
+Thread* thread_current();
+
+void preempt_disable();
+void preempt_enable();
+
+// Called by interrupt_dispatch after the EOI; switches away from the
+// interrupted thread if the tick or a wakeup asked for it
+void sched_irq_exit();
+
+// Per-CPU time slice accounting; the local APIC timer calls this on the
+// application processors (the boot CPU is charged from IRQ0)
+void sched_timer_tick();
+
+// SMP bring-up: claim CPU 'cpu's idle thread and return the top of its
+// stack, which the AP starts on; the AP then calls sched_ap_enter(), which
+// marks it online and never returns
+uint32_t sched_prepare_cpu(uint32_t cpu);
+void sched_ap_enter(uint32_t cpu) __attribute__((noreturn));
+bool sched_cpu_online(uint32_t cpu);
+
+struct SchedCpuStats {
+    uint32_t ticks;
+    uint32_t switches;
+    uint32_t steals;            // threads taken from other CPUs' queues
+    const char* running;
+};
+
+void sched_cpu_stats(uint32_t cpu, SchedCpuStats& stats);
+
+// One line per thread: id, name, priority, state, CPU, switches,
+// preemptions and stack high-water mark
+void threads_print(OutputStream& out);
+
+#endif // THREAD_H
@@ -0,0 +1,177 @@
+/*
+ * RusticOS event tracing
+ * ----------------------
+ * A record is written by the CPU it describes, into that CPU's ring, with
+ * interrupts disabled: an IRQ's own trace points cannot interleave with a
+ * half-written record, and the thread cannot migrate between reading
+ * cpu_index() and bumping the head. No CPU ever touches another's ring
+ * while tracing runs, so the rings need no lock.
+ *
+ * Dump format (little endian, as the records sit in memory):
+ *   "RTRC" u16 version, u16 cpus, u32 tsc_khz, u32 names, u32 records
+ *   names x { u32 pointer, u16 length, bytes }
+ *   records x TraceRecord (16 bytes), oldest first per CPU
+ *   "RTRE"
+ */
+
+#include "trace.h"
+#include "smp.h"
+#include "cpu.h"
+#include "io.h"
+#include "clock.h"
+#include "klog.h"
+#include "serial.h"
+#include "kprintf.h"
+#include "stream.h"
+#include "kstats.h"
+#include <cstring>
+
+#define TRACE_RING_MASK    (TRACE_RING_RECORDS - 1)
+#define TRACE_DUMP_VERSION 1
+#define TRACE_MAX_NAMES    64       // distinct names sent per dump
+#define TRACE_DUMP_CHUNK   16       // records per serial write
+
+static_assert((TRACE_RING_RECORDS & TRACE_RING_MASK) == 0, "TRACE_RING_RECORDS must be a power of two");
+
+struct TraceRing {
+    uint32_t head;                  // records ever written; slot = head & mask
+    TraceRecord records[TRACE_RING_RECORDS];
+} __attribute__((aligned(64)));
+
+struct TraceDumpHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t cpus;
+    uint32_t tsc_khz;
+    uint32_t names;
+    uint32_t records;
+} __attribute__((packed));
+
+struct TraceDumpName {
+    uint32_t pointer;
+    uint16_t length;
+} __attribute__((packed));
+
+volatile bool trace_enabled = false;
+static TraceRing rings[MAX_CPUS];
+
+KSTAT_COUNTER(stat_trace_dumps, "trace.dumps");
+
+void trace_record(const char* name, uint8_t type, uint16_t arg) {
+    uint32_t flags = irq_save();
+    uint64_t tsc = rdtsc();
+    uint32_t cpu = cpu_index();
+    TraceRing& ring = rings[cpu];
+    TraceRecord& rec = ring.records[ring.head++ & TRACE_RING_MASK];
+    rec.tsc = tsc;
+    rec.name = name;
+    rec.type = type;
+    rec.cpu = (uint8_t)cpu;
+    rec.arg = arg;
+    irq_restore(flags);
+}
+
+void trace_clear() {
+    // Only called with tracing stopped, or from trace_start() before it runs
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; ++cpu) {
+        rings[cpu].head = 0;
+    }
+}
+
+void trace_start() {
+    if (!clock_has_tsc()) {
+        return;
+    }
+    trace_enabled = false;
+    trace_clear();
+    __atomic_store_n(&trace_enabled, true, __ATOMIC_RELEASE);
+}
+
+void trace_stop() {
+    __atomic_store_n(&trace_enabled, false, __ATOMIC_RELEASE);
+}
+
+static uint32_t retained(const TraceRing& ring) {
+    return ring.head < TRACE_RING_RECORDS ? ring.head : TRACE_RING_RECORDS;
+}
+
+void trace_status(OutputStream& out) {
+    uint32_t records = 0, overwritten = 0;
+    for (uint32_t cpu = 0; cpu < smp_cpu_count(); ++cpu) {
+        records += retained(rings[cpu]);
+        overwritten += rings[cpu].head - retained(rings[cpu]);
+    }
+    kfprintf(out, "trace: %s, %u records on %u CPUs, %u overwritten, %u per CPU\n",
+             trace_enabled ? "running" : (clock_has_tsc() ? "stopped" : "unavailable (no TSC)"),
+             records, smp_cpu_count(), overwritten, TRACE_RING_RECORDS);
+}
+
+// Distinct name pointers in the retained records, first seen first
+static uint32_t collect_names(const char** names) {
+    uint32_t count = 0;
+    for (uint32_t cpu = 0; cpu < smp_cpu_count(); ++cpu) {
+        const TraceRing& ring = rings[cpu];
+        for (uint32_t i = 0; i < retained(ring); ++i) {
+            const char* name = ring.records[i].name;
+            uint32_t n = 0;
+            while (n < count && names[n] != name) n++;
+            if (n == count && count < TRACE_MAX_NAMES) {
+                names[count++] = name;
+            }
+        }
+    }
+    return count;
+}
+
+void trace_dump(OutputStream& out) {
+    trace_stop();
+
+    const char* names[TRACE_MAX_NAMES];
+    uint32_t name_count = collect_names(names);
+    uint32_t cpus = smp_cpu_count();
+
+    TraceDumpHeader header;
+    memcpy(header.magic, "RTRC", 4);
+    header.version = TRACE_DUMP_VERSION;
+    header.cpus = (uint16_t)cpus;
+    header.tsc_khz = clock_tsc_khz();
+    header.names = name_count;
+    header.records = 0;
+    for (uint32_t cpu = 0; cpu < cpus; ++cpu) {
+        header.records += retained(rings[cpu]);
+    }
+
+    // A log line in the middle of the block would corrupt it
+    uint8_t saved_level = klog.setSerialLevel(LOG_ERROR + 1);
+    serial.write((const char*)&header, sizeof(header));
+    uint32_t bytes = sizeof(header);
+
+    for (uint32_t n = 0; n < name_count; ++n) {
+        TraceDumpName entry = { (uint32_t)names[n], (uint16_t)strlen(names[n]) };
+        serial.write((const char*)&entry, sizeof(entry));
+        serial.write(names[n], entry.length);
+        bytes += sizeof(entry) + entry.length;
+    }
+
+    // Small writes: serial.write() holds interrupts off while the ring is full
+    for (uint32_t cpu = 0; cpu < cpus; ++cpu) {
+        const TraceRing& ring = rings[cpu];
+        uint32_t count = retained(ring);
+        uint32_t first = ring.head - count;
+        for (uint32_t i = 0; i < count; ) {
+            uint32_t slot = (first + i) & TRACE_RING_MASK;
+            uint32_t chunk = count - i;
+            if (chunk > TRACE_DUMP_CHUNK) chunk = TRACE_DUMP_CHUNK;
+            if (chunk > TRACE_RING_RECORDS - slot) chunk = TRACE_RING_RECORDS - slot;
+            serial.write((const char*)&ring.records[slot], chunk * (uint32_t)sizeof(TraceRecord));
+            i += chunk;
+        }
+    }
+    serial.write("RTRE", 4);
+    bytes += header.records * sizeof(TraceRecord) + 4;
+    klog.setSerialLevel(saved_level);
+    kstat_inc(stat_trace_dumps);
+
+    trace_status(out);
+    kfprintf(out, "trace: %u bytes sent to COM1 (scripts/trace_to_chrome.py)\n", bytes);
+}
@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+class OutputStream;
+
+/*
+ * Event tracing
+ * -------------
+ * - TRACE_BEGIN/TRACE_END bracket a span, TRACE_INSTANT marks a point and
+ *   TRACE_SCOPE closes its span when the enclosing block exits. Each takes
+ *   a string literal name (only the pointer is stored) and a 16-bit
+ *   argument (an LBA, a vector, a length)
+ * - Records are 16 bytes: TSC, name, type, CPU and argument. Every CPU has
+ *   its own ring of TRACE_RING_RECORDS; once it wraps the oldest records
+ *   are overwritten, so a dump holds the most recent activity
+ * - Disabled (the default), a trace point is one load and a branch.
+ *   Enabled, it is rdtsc plus a handful of stores with interrupts held off
+ *   on this CPU only; there are no locks or shared cache lines
+ * - Spans are attributed to the CPU they were recorded on, so a span must
+ *   begin and end on the same CPU: only trace across code that cannot
+ *   migrate (IRQ handlers, pinned threads, or with preemption disabled)
+ * - trace_dump() sends the rings to COM1 as one binary block;
+ *   scripts/trace_to_chrome.py turns a capture into Chrome/Perfetto JSON
+ */
+
+#define TRACE_RING_RECORDS 1024     // per CPU, must be a power of two
+
+#define TRACE_TYPE_BEGIN   'B'
+#define TRACE_TYPE_END     'E'
+#define TRACE_TYPE_INSTANT 'i'
+
+struct TraceRecord {
+    uint64_t tsc;
+    const char* name;
+    uint8_t type;
+    uint8_t cpu;
+    uint16_t arg;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is part of the dump format");
+
+extern volatile bool trace_enabled;
+
+void trace_record(const char* name, uint8_t type, uint16_t arg);
+
+void trace_start();             // clears the rings
+void trace_stop();
+void trace_clear();
+
+// Sends the rings to COM1 and a one-line summary to 'out'
+void trace_dump(OutputStream& out);
+void trace_status(OutputStream& out);
+
+static inline void trace_point(const char* name, uint8_t type, uint16_t arg) {
+    if (__builtin_expect(trace_enabled, 0)) {
+        trace_record(name, type, arg);
+    }
+}
+
+class TraceScope {
+private:
+    const char* name;
+
+public:
+    TraceScope(const char* span, uint16_t arg) : name(span) {
+        trace_point(name, TRACE_TYPE_BEGIN, arg);
+    }
+    ~TraceScope() {
+        trace_point(name, TRACE_TYPE_END, 0);
+    }
+};
+
+#define TRACE_BEGIN(name, arg)   trace_point((name), TRACE_TYPE_BEGIN, (uint16_t)(arg))
+#define TRACE_END(name)          trace_point((name), TRACE_TYPE_END, 0)
+#define TRACE_INSTANT(name, arg) trace_point((name), TRACE_TYPE_INSTANT, (uint16_t)(arg))
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, arg) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)((name), (uint16_t)(arg))
+
+#endif // TRACE_H
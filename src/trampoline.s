@@ -0,0 +1,74 @@
+# ============================================================================
+# RusticOS - Application processor trampoline
+# ----------------------------------------------------------------------------
+# A STARTUP IPI starts an AP in real mode at CS:IP = (vector << 8):0000, so
+# this blob is copied to AP_TRAMPOLINE_BASE (a page below 1 MiB) and
+# assembled to run there. It loads its own flat GDT, enters protected mode
+# and calls the C entry with the stack and CPU index the boot CPU patched
+# into the parameter block at the end.
+#
+# APs are started one at a time, so one copy and one parameter block are
+# enough. The GDT stays in use until the AP is halted, so the page must not
+# be reused afterwards.
+# ============================================================================
+
+.set AP_TRAMPOLINE_BASE, 0x8000
+
+.global ap_trampoline_start
+.global ap_trampoline_end
+.global ap_trampoline_stack
+.global ap_trampoline_entry
+.global ap_trampoline_cpu
+
+.section .text
+
+.code16
+ap_trampoline_start:
+    cli
+    cld
+    xorw %ax, %ax
+    movw %ax, %ds
+    lgdtl AP_TRAMPOLINE_BASE + (ap_gdt_ptr - ap_trampoline_start)
+
+    movl %cr0, %eax
+    orl $1, %eax                # PE
+    movl %eax, %cr0
+    ljmpl $0x08, $(AP_TRAMPOLINE_BASE + (ap_pm32 - ap_trampoline_start))
+
+.code32
+ap_pm32:
+    movw $0x10, %ax
+    movw %ax, %ds
+    movw %ax, %es
+    movw %ax, %fs
+    movw %ax, %gs
+    movw %ax, %ss
+    movl AP_TRAMPOLINE_BASE + (ap_trampoline_stack - ap_trampoline_start), %esp
+
+    pushl AP_TRAMPOLINE_BASE + (ap_trampoline_cpu - ap_trampoline_start)
+    movl AP_TRAMPOLINE_BASE + (ap_trampoline_entry - ap_trampoline_start), %eax
+    call *%eax
+
+1:  cli
+    hlt
+    jmp 1b
+
+# Same layout as the loader's GDT: 0x08 flat code, 0x10 flat data
+.align 8
+ap_gdt:
+    .quad 0
+    .quad 0x00CF9A000000FFFF
+    .quad 0x00CF92000000FFFF
+ap_gdt_ptr:
+    .word 3 * 8 - 1
+    .long AP_TRAMPOLINE_BASE + (ap_gdt - ap_trampoline_start)
+
+# Parameter block, written by smp_init() before each STARTUP IPI
+.align 4
+ap_trampoline_stack:
+    .long 0
+ap_trampoline_entry:
+    .long 0
+ap_trampoline_cpu:
+    .long 0
+ap_trampoline_end:
@@ -0,0 +1,80 @@
+/*
+ * RusticOS virtual consoles
+ * -------------------------
+ * VC_SHELL is the global 'terminal'; the other consoles are allocated here.
+ * When a framebuffer console is active it follows the displayed terminal.
+ */
+
+#include "vconsole.h"
+#include "fbconsole.h"
+
+VirtualConsoles vconsoles;
+
+static Terminal extra_consoles[NUM_VIRTUAL_CONSOLES - 1];
+
+static const uint16_t HISTORY_PAGE = 12;
+
+void VirtualConsoles::init() {
+    consoles[VC_SHELL] = &terminal;
+    for (uint8_t i = 1; i < NUM_VIRTUAL_CONSOLES; ++i) {
+        consoles[i] = &extra_consoles[i - 1];
+    }
+
+    // The shell console adopts what the boot code already put on screen
+    active = VC_SHELL;
+    terminal.show(true);
+    if (fbcon.is_active()) {
+        // Wrap and scroll where the text terminals do
+        fbcon.setTextArea(terminal.getWidth(), terminal.getHeight());
+        terminal.setMirror(&fbcon);
+    }
+}
+
+void VirtualConsoles::switch_to(uint8_t index) {
+    if (index >= NUM_VIRTUAL_CONSOLES || index == active) return;
+
+    Terminal& old_console = *consoles[active];
+    Terminal& new_console = *consoles[index];
+
+    old_console.hide();
+    old_console.setMirror(nullptr);
+    new_console.show();
+    active = index;
+
+    if (fbcon.is_active()) {
+        fbcon.renderText(new_console.getCells(), new_console.getWidth(), new_console.getHeight(),
+                         new_console.getCursorX(), new_console.getCursorY());
+        new_console.setMirror(&fbcon);
+    }
+}
+
+bool VirtualConsoles::handle_key(const KeyEvent& event) {
+    if (!event.pressed) return false;
+
+    if (event.alt && event.scan_code >= KEY_F1 && event.scan_code < KEY_F1 + NUM_VIRTUAL_CONSOLES) {
+        switch_to(event.scan_code - KEY_F1);
+        return true;
+    }
+
+    if (event.scan_code == KEY_LEFT_SHIFT || event.scan_code == KEY_RIGHT_SHIFT ||
+        event.scan_code == KEY_LEFT_CTRL || event.scan_code == KEY_LEFT_ALT) {
+        return false;
+    }
+
+    Terminal& console = current();
+    if (event.shift && event.scan_code == KEY_PAGE_UP) {
+        console.setScrollOffset(console.getScrollOffset() + HISTORY_PAGE);
+        return true;
+    }
+    if (event.shift && event.scan_code == KEY_PAGE_DOWN) {
+        uint16_t offset = console.getScrollOffset();
+        console.setScrollOffset(offset > HISTORY_PAGE ? offset - HISTORY_PAGE : 0);
+        return true;
+    }
+
+    // Any other key snaps back to the live view
+    if (console.getScrollOffset() != 0) {
+        console.setScrollOffset(0);
+    }
+    return false;
+}
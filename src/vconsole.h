@@ -0,0 +1,46 @@
+#ifndef VCONSOLE_H
+#define VCONSOLE_H
+
+#include "types.h"
+#include "terminal.h"
+
+/*
+ * Virtual consoles for RusticOS
+ * -----------------------------
+ * - NUM_VIRTUAL_CONSOLES independent Terminals, each with its own back
+ *   buffer, cursor and scrollback
+ * - Exactly one is displayed; switching hides the old one (VGA -> RAM) and
+ *   shows the new one (RAM -> VGA) with two 4 KB copies
+ * - Alt+F1..F4 switch consoles, Shift+PageUp/PageDown browse scrollback
+ * - With a framebuffer console, the displayed terminal is mirrored into
+ *   its top-left 80x25 cells; switching and scrollback re-render it there
+ *
+ * Console assignment: VC_SHELL is the global 'terminal' used by the command
+ * shell, VC_LOG receives a copy of every kernel log record.
+ */
+
+#define NUM_VIRTUAL_CONSOLES 4
+#define VC_SHELL 0
+#define VC_LOG   1
+
+class VirtualConsoles {
+private:
+    Terminal* consoles[NUM_VIRTUAL_CONSOLES];
+    uint8_t active;
+
+public:
+    void init();
+
+    Terminal& get(uint8_t index) { return *consoles[index]; }
+    Terminal& current() { return *consoles[active]; }
+    uint8_t current_index() const { return active; }
+
+    void switch_to(uint8_t index);
+
+    // Console hot keys; returns true if the event was consumed
+    bool handle_key(const KeyEvent& event);
+};
+
+extern VirtualConsoles vconsoles;
+
+#endif // VCONSOLE_H
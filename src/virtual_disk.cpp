@@ -1,10 +1,15 @@
 #include <cstdint>
 #include "virtual_disk.h"
+#include "kstats.h"
+#include "trace.h"
 
 static uint8_t VDISK_BUFFER[VDISK_SECTOR_SIZE * VDISK_NUM_SECTORS];
 
 VirtualDisk vdisk;
 
+KSTAT_COUNTER(stat_sector_reads, "disk.sector_reads");
+KSTAT_COUNTER(stat_sector_writes, "disk.sector_writes");
+
 VirtualDisk::VirtualDisk() {
     // Optionally zero on startup
 }
@@ -17,6 +22,8 @@ void VirtualDisk::clear() {
 
 bool VirtualDisk::read_sector(uint32_t lba, void* out_buffer) {
     if (!out_buffer || lba >= VDISK_NUM_SECTORS) return false;
+    kstat_inc(stat_sector_reads);
+    TRACE_SCOPE("disk.read", lba);
     uint8_t* dst = reinterpret_cast<uint8_t*>(out_buffer);
     const uint8_t* src = &VDISK_BUFFER[lba * VDISK_SECTOR_SIZE];
     for (uint32_t i = 0; i < VDISK_SECTOR_SIZE; ++i) dst[i] = src[i];
@@ -25,6 +32,8 @@ bool VirtualDisk::read_sector(uint32_t lba, void* out_buffer) {
 
 bool VirtualDisk::write_sector(uint32_t lba, const void* in_buffer) {
     if (!in_buffer || lba >= VDISK_NUM_SECTORS) return false;
+    kstat_inc(stat_sector_writes);
+    TRACE_SCOPE("disk.write", lba);
     const uint8_t* src = reinterpret_cast<const uint8_t*>(in_buffer);
     uint8_t* dst = &VDISK_BUFFER[lba * VDISK_SECTOR_SIZE];
     for (uint32_t i = 0; i < VDISK_SECTOR_SIZE; ++i) dst[i] = src[i];
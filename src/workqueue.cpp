@@ -0,0 +1,170 @@
+/*
+ * RusticOS deferred work
+ * ----------------------
+ * One spinlock guards the free list and the pending FIFO; queueing is a
+ * pop from one and an append to the other, with interrupts disabled so
+ * IRQ handlers can queue too. The worker detaches the whole pending list
+ * at once, runs it without the lock, and returns the batch to the free
+ * list in a single splice.
+ */
+
+#include "workqueue.h"
+#include "thread.h"
+#include "spinlock.h"
+#include "klog.h"
+#include "kstats.h"
+#include <cstring>
+
+struct WorkItem {
+    WorkFn fn;
+    void* arg;
+    WorkItem* next;
+    uint8_t data[WORK_DATA_SIZE];
+};
+
+static WorkItem pool[WORK_POOL_SIZE];
+static WorkItem* free_list = nullptr;
+static WorkItem* pending_head = nullptr;
+static WorkItem* pending_tail = nullptr;
+static Spinlock lock;
+static Thread* worker = nullptr;
+
+KSTAT_COUNTER(stat_work_queued, "work.queued");
+KSTAT_COUNTER(stat_work_coalesced, "work.coalesced");
+KSTAT_COUNTER(stat_work_dropped, "work.dropped");
+KSTAT_COUNTER(stat_work_batches, "work.batches");
+KSTAT_COUNTER(stat_work_executed, "work.executed");
+
+static bool enqueue(WorkFn fn, void* arg, const void* data, uint32_t size, bool once) {
+    uint32_t flags = lock.lock_irqsave();
+    if (once) {
+        for (WorkItem* item = pending_head; item; item = item->next) {
+            if (item->fn == fn && item->arg == arg) {
+                lock.unlock_irqrestore(flags);
+                kstat_inc(stat_work_coalesced);
+                return true;
+            }
+        }
+    }
+
+    WorkItem* item = free_list;
+    if (!item) {
+        lock.unlock_irqrestore(flags);
+        kstat_inc(stat_work_dropped);
+        return false;
+    }
+    free_list = item->next;
+
+    item->fn = fn;
+    item->arg = arg;
+    if (data) {
+        memcpy(item->data, data, size);
+        item->arg = item->data;
+    }
+    item->next = nullptr;
+    if (pending_tail) {
+        pending_tail->next = item;
+    } else {
+        pending_head = item;
+    }
+    pending_tail = item;
+    lock.unlock_irqrestore(flags);
+
+    kstat_inc(stat_work_queued);
+    thread_wake(worker);
+    return true;
+}
+
+static void worker_main(void*) {
+    for (;;) {
+        uint32_t flags = lock.lock_irqsave();
+        WorkItem* batch = pending_head;
+        pending_head = pending_tail = nullptr;
+        lock.unlock_irqrestore(flags);
+
+        if (!batch) {
+            thread_block();
+            continue;
+        }
+
+        WorkItem* last = batch;
+        uint32_t count = 0;
+        for (WorkItem* item = batch; item; item = item->next) {
+            item->fn(item->arg);
+            last = item;
+            count++;
+        }
+
+        flags = lock.lock_irqsave();
+        last->next = free_list;
+        free_list = batch;
+        lock.unlock_irqrestore(flags);
+
+        kstat_inc(stat_work_batches);
+        kstat_add(stat_work_executed, count);
+    }
+}
+
+void work_init() {
+    for (uint32_t i = 0; i < WORK_POOL_SIZE; ++i) {
+        pool[i].next = (i + 1 < WORK_POOL_SIZE) ? &pool[i + 1] : nullptr;
+    }
+    free_list = &pool[0];
+
+    // Created before the other CPUs are up, so it is pinned before anyone
+    // could steal it
+    Thread* thread = thread_create("kworker", worker_main, nullptr, PRIORITY_NORMAL);
+    if (!thread) {
+        klog.error("work: no thread slot for the worker");
+        return;
+    }
+    thread_pin(thread);
+    __atomic_store_n(&worker, thread, __ATOMIC_RELEASE);
+    klog.logf(LOG_INFO, "work: %u items of %u bytes", WORK_POOL_SIZE, (uint32_t)sizeof(WorkItem));
+}
+
+bool work_ready() {
+    return __atomic_load_n(&worker, __ATOMIC_ACQUIRE) != nullptr;
+}
+
+bool work_queue(WorkFn fn, void* arg) {
+    if (!work_ready()) return false;
+    return enqueue(fn, arg, nullptr, 0, false);
+}
+
+bool work_queue_once(WorkFn fn, void* arg) {
+    if (!work_ready()) return false;
+    return enqueue(fn, arg, nullptr, 0, true);
+}
+
+bool work_queue_data(WorkFn fn, const void* data, uint32_t size) {
+    if (!work_ready() || size > WORK_DATA_SIZE) return false;
+    return enqueue(fn, nullptr, data, size, false);
+}
+
+struct FlushWaiter {
+    Thread* thread;
+    bool done;
+};
+
+static void flush_done(void* arg) {
+    FlushWaiter* waiter = (FlushWaiter*)arg;
+    // The waiter's frame may be gone as soon as 'done' is seen
+    Thread* thread = waiter->thread;
+    __atomic_store_n(&waiter->done, true, __ATOMIC_RELEASE);
+    thread_wake(thread);
+}
+
+void work_flush() {
+    // The worker would be waiting for itself
+    if (!work_ready() || thread_current() == worker) {
+        return;
+    }
+    FlushWaiter waiter = { thread_current(), false };
+    while (!work_queue(flush_done, &waiter)) {
+        thread_yield();
+    }
+    while (!__atomic_load_n(&waiter.done, __ATOMIC_ACQUIRE)) {
+        thread_block();
+    }
+}
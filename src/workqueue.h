@@ -0,0 +1,46 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "types.h"
+
+/*
+ * Deferred work
+ * -------------
+ * - work_queue*() hand a function call to the "kworker" thread. They may
+ *   be called from IRQ handlers and from any thread on any CPU, never
+ *   block, and fail (counted in work.dropped) only when the pool of
+ *   WORK_POOL_SIZE items is exhausted
+ * - Items are fixed-size and come from a static pool: a function, a
+ *   pointer argument and optionally WORK_DATA_SIZE bytes copied in at
+ *   queue time (for IRQ handlers that must not keep a pointer to their
+ *   own state)
+ * - The worker takes everything pending in one lock acquisition and runs
+ *   the batch in FIFO order. work_queue_once() coalesces: if the same
+ *   function/argument pair is still pending, nothing new is queued, so a
+ *   burst of "something changed" events costs one run of the expensive
+ *   follow-up
+ * - The worker is pinned to the boot CPU, so work functions run one at a
+ *   time, next to the "main" thread, in thread context: they may sleep,
+ *   log and use the console
+ * - Before work_init() nothing runs the queue; callers that can be reached
+ *   that early check work_ready() and do the work inline
+ */
+
+#define WORK_POOL_SIZE 64
+#define WORK_DATA_SIZE 16
+
+typedef void (*WorkFn)(void* arg);
+
+void work_init();
+bool work_ready();
+
+bool work_queue(WorkFn fn, void* arg);
+bool work_queue_once(WorkFn fn, void* arg);
+
+// fn receives a pointer to the copy, valid for the duration of the call
+bool work_queue_data(WorkFn fn, const void* data, uint32_t size);
+
+// Wait until everything queued before the call has run (thread context)
+void work_flush();
+
+#endif // WORKQUEUE_H